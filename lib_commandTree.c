@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "lib_globExpand.h"
+#include "lib_commandTree.h"
+
+typedef struct cache_entry {
+    char *line; // raw line as typed, NULL if slot is empty
+    cmd_node *tree;
+    int wants_background; // line ended with &
+} cache_entry;
+
+static cache_entry cache[CACHE_SLOTS];
+static long cacheHits = 0, cacheMisses = 0;
+
+typedef struct parser {
+    char *text; // line being parsed
+    int pos; // index of the next unread character
+    int depth; // number of open groups, ; and ) only separate inside one
+    char *error; // first syntax error found, NULL if none
+} parser;
+
+static cmd_node *parse_command(parser *);
+static cmd_node *parse_list(parser *, char *);
+
+
+/***************************************************************
+ * skip_spaces
+ * Parameters: parser *p
+ * Advances past spaces
+****************************************************************/
+static void skip_spaces(parser *p){
+    while (p->text[p->pos] == ' '){
+        p->pos++;
+    }
+}
+
+/***************************************************************
+ * ends_word
+ * Parameters: parser *p, char c
+ * Returns 1 if c ends a word. Outside of a group only spaces do,
+ * so ; ( and ) stay ordinary characters in plain commands.
+****************************************************************/
+static int ends_word(parser *p, char c){
+    return (c == '\0' || c == ' ' || (p->depth > 0 && (c == ';' || c == ')')));
+}
+
+/***************************************************************
+ * at_word
+ * Parameters: parser *p, char *word
+ * Returns 1 if the next word is exactly word
+****************************************************************/
+static int at_word(parser *p, char *word){
+    int len = strlen(word);
+
+    return (strncmp(p->text + p->pos, word, len) == 0 &&
+            ends_word(p, p->text[p->pos + len]));
+}
+
+/***************************************************************
+ * read_word
+ * Parameters: parser *p
+ * Returns a copy of the next word, or NULL if there is none
+****************************************************************/
+static char *read_word(parser *p){
+    int start;
+
+    skip_spaces(p);
+    start = p->pos;
+    while (ends_word(p, p->text[p->pos]) == 0){
+        p->pos++;
+    }
+
+    if (p->pos == start){
+        return NULL;
+    }
+    return strndup(p->text + start, p->pos - start);
+}
+
+/***************************************************************
+ * new_node
+ * Parameters: int type
+ * Returns an empty node of type
+****************************************************************/
+static cmd_node *new_node(int type){
+    cmd_node *node = calloc(1, sizeof(cmd_node));
+
+    if (node != NULL){
+        node->type = type;
+    }
+    return node;
+}
+
+/***************************************************************
+ * set_error
+ * Parameters: parser *p, char *message
+ * Records message unless an earlier error was already found
+****************************************************************/
+static void set_error(parser *p, char *message){
+    if (p->error == NULL){
+        p->error = message;
+    }
+}
+
+/***************************************************************
+ * word_flags
+ * Parameters: char *word
+ * Returns the WORD_ bits for word, so expansion work can be
+ * skipped for plain words every time the tree is run.
+****************************************************************/
+static unsigned char word_flags(char *word){
+    unsigned char flags = 0;
+    char *dollar;
+
+    // $ followed by { or a name is a variable reference
+    for (dollar = strchr(word, '$'); dollar != NULL; dollar = strchr(dollar + 1, '$')){
+        if (dollar[1] == '{' || dollar[1] == '_' || isalpha((unsigned char)dollar[1])){
+            flags |= WORD_VARS;
+            break;
+        }
+    }
+
+    if (has_glob(word) == 1){
+        flags |= WORD_GLOB;
+    }
+
+    return flags;
+}
+
+/***************************************************************
+ * add_word
+ * Parameters: cmd_node *node, char *word
+ * Appends word and its expansion flags to node. Returns 0 on
+ * success or -1 if memory could not be allocated.
+****************************************************************/
+static int add_word(cmd_node *node, char *word){
+    char **grownWords = realloc(node->words, (node->num_words + 2) * sizeof(char *));
+    unsigned char *grownFlags;
+
+    if (grownWords == NULL){
+        return -1;
+    }
+    node->words = grownWords;
+
+    grownFlags = realloc(node->word_flags, node->num_words + 1);
+    if (grownFlags == NULL){
+        return -1;
+    }
+    node->word_flags = grownFlags;
+
+    node->word_flags[node->num_words] = word_flags(word);
+    node->words[node->num_words++] = word;
+    node->words[node->num_words] = NULL;
+    return 0;
+}
+
+/***************************************************************
+ * parse_redirection
+ * Parameters: parser *p, cmd_node *node
+ * If the next word is < or >, reads the file name that follows
+ * into node and returns 1. Otherwise returns 0.
+****************************************************************/
+static int parse_redirection(parser *p, cmd_node *node){
+    char **target;
+
+    skip_spaces(p);
+    if (at_word(p, "<")){
+        target = &node->in_file;
+    } else if (at_word(p, ">")){
+        target = &node->out_file;
+    } else {
+        return 0;
+    }
+
+    p->pos++;
+    free(*target);
+    *target = read_word(p);
+    if (*target == NULL){
+        set_error(p, "missing file name after redirection");
+    }
+    return 1;
+}
+
+/***************************************************************
+ * parse_simple
+ * Parameters: parser *p
+ * Reads words and redirections up to the end of the command.
+****************************************************************/
+static cmd_node *parse_simple(parser *p){
+    cmd_node *node = new_node(NODE_SIMPLE);
+    char *word;
+
+    if (node == NULL){
+        set_error(p, "out of memory");
+        return NULL;
+    }
+
+    while (p->error == NULL){
+        if (parse_redirection(p, node)){
+            continue;
+        }
+
+        word = read_word(p);
+        if (word == NULL){ // end of line, ; or )
+            break;
+        }
+
+        if (add_word(node, word) == -1){
+            free(word);
+            set_error(p, "out of memory");
+        }
+    }
+
+    if (node->num_words == 0){
+        set_error(p, "missing command");
+    }
+    return node;
+}
+
+/***************************************************************
+ * expect_word
+ * Parameters: parser *p, char *word
+ * Consumes word if it is next, otherwise records a syntax error
+****************************************************************/
+static void expect_word(parser *p, char *word){
+    static char message[64];
+
+    skip_spaces(p);
+    if (p->error == NULL && at_word(p, word)){
+        p->pos += strlen(word);
+    } else {
+        snprintf(message, sizeof(message), "expected %s", word);
+        set_error(p, message);
+    }
+}
+
+/***************************************************************
+ * parse_loop
+ * Parameters: parser *p, cmd_node *node
+ * Parses the rest of a for or while loop after its keyword:
+ * for: var in words; do list; done
+ * while: list; do list; done
+****************************************************************/
+static void parse_loop(parser *p, cmd_node *node){
+    char *word;
+
+    if (node->type == NODE_FOR){
+        node->var = read_word(p);
+        if (node->var == NULL){
+            set_error(p, "missing for loop variable");
+            return;
+        }
+        expect_word(p, "in");
+
+        // words up to ; are the values of var
+        while (p->error == NULL && (word = read_word(p)) != NULL){
+            if (add_word(node, word) == -1){
+                free(word);
+                set_error(p, "out of memory");
+            }
+        }
+        skip_spaces(p);
+        if (p->text[p->pos] == ';'){
+            p->pos++;
+        }
+    } else {
+        node->cond = parse_list(p, "do");
+    }
+
+    expect_word(p, "do");
+    if (p->error == NULL){
+        node->body = parse_list(p, "done");
+    }
+    expect_word(p, "done");
+}
+
+/***************************************************************
+ * parse_command
+ * Parameters: parser *p
+ * Parses one command: ( list ), { list; }, a for or while loop
+ * or a simple command. Groups and loops may be followed by
+ * redirections for the whole group or loop.
+****************************************************************/
+static cmd_node *parse_command(parser *p){
+    cmd_node *node;
+    char *closer = NULL;
+
+    skip_spaces(p);
+    if (p->text[p->pos] == '('){
+        node = new_node(NODE_SUBSHELL);
+        closer = ")";
+    } else if (at_word(p, "{")){
+        node = new_node(NODE_GROUP);
+        closer = "}";
+    } else if (at_word(p, "for")){
+        node = new_node(NODE_FOR);
+    } else if (at_word(p, "while")){
+        node = new_node(NODE_WHILE);
+    } else {
+        return parse_simple(p);
+    }
+
+    if (node == NULL){
+        set_error(p, "out of memory");
+        return NULL;
+    }
+
+    p->depth++;
+    if (closer != NULL){
+        p->pos++;
+        node->body = parse_list(p, closer);
+        if (p->error == NULL){
+            p->pos++; // past the closer
+        }
+    } else {
+        p->pos += (node->type == NODE_FOR) ? 3 : 5;
+        parse_loop(p, node);
+    }
+    p->depth--;
+
+    while (p->error == NULL && parse_redirection(p, node)){
+        continue;
+    }
+    return node;
+}
+
+/***************************************************************
+ * parse_list
+ * Parameters: parser *p, char *closer
+ * Parses ; separated commands until closer, which is left unread.
+ * closer is ) or a word such as }, do or done.
+****************************************************************/
+static cmd_node *parse_list(parser *p, char *closer){
+    static char message[64];
+    cmd_node *head = NULL, **tail = &head;
+
+    while (p->error == NULL){
+        skip_spaces(p);
+
+        if ((strcmp(closer, ")") == 0) ? (p->text[p->pos] == ')') : at_word(p, closer)){
+            break;
+        }
+        if (p->text[p->pos] == '\0'){
+            snprintf(message, sizeof(message), "missing %s", closer);
+            set_error(p, message);
+            break;
+        }
+
+        *tail = parse_command(p);
+        if (*tail == NULL){
+            break;
+        }
+        tail = &(*tail)->next;
+
+        skip_spaces(p);
+        if (p->text[p->pos] == ';'){
+            p->pos++;
+        }
+    }
+
+    if (head == NULL){
+        set_error(p, "empty command list");
+    }
+    return head;
+}
+
+/***************************************************************
+ * parse_line
+ * Parameters: char *line
+ * Parses a command line into a command tree. A line is either a
+ * plain command, where ; and parentheses have no special meaning,
+ * or a ( list ) / { list; } group or for / while loop followed by
+ * optional redirections. Displays the problem and returns NULL if the line
+ * is not valid.
+****************************************************************/
+cmd_node *parse_line(char *line){
+    parser p = {line, 0, 0, NULL};
+    cmd_node *tree = parse_command(&p);
+
+    skip_spaces(&p);
+    if (p.error == NULL && p.text[p.pos] != '\0'){
+        set_error(&p, "unexpected text after command group or loop");
+    }
+
+    if (p.error != NULL){
+        printf("Unable to parse command: %s.\n", p.error);
+        fflush(stdout);
+        free_tree(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+/***************************************************************
+ * free_tree
+ * Parameters: cmd_node *tree
+ * Free's every node of a command list and their groups
+****************************************************************/
+void free_tree(cmd_node *tree){
+    cmd_node *next;
+    int i;
+
+    while (tree != NULL){
+        next = tree->next;
+
+        for (i = 0; i < tree->num_words; i++){
+            free(tree->words[i]);
+        }
+        free(tree->words);
+        free(tree->word_flags);
+        free(tree->var);
+        free(tree->in_file);
+        free(tree->out_file);
+        free_tree(tree->cond);
+        free_tree(tree->body);
+        free(tree);
+
+        tree = next;
+    }
+}
+
+/***************************************************************
+ * hash_line
+ * Parameters: char *line
+ * FNV-1a hash of line, used to pick a cache slot
+****************************************************************/
+static unsigned long hash_line(char *line){
+    unsigned long hash = 2166136261UL;
+
+    while (*line != '\0'){
+        hash = (hash ^ (unsigned char)*line++) * 16777619UL;
+    }
+    return hash;
+}
+
+/***************************************************************
+ * cache_lookup
+ * Parameters: char *line, int *wantsBackground
+ * Returns the tree parsed earlier for the identical raw line, or
+ * NULL on a miss. On a hit, wantsBackground is set if the line
+ * ended with &. The cache keeps ownership of the tree.
+****************************************************************/
+cmd_node *cache_lookup(char *line, int *wantsBackground){
+    cache_entry *entry = &cache[hash_line(line) % CACHE_SLOTS];
+
+    if (entry->line == NULL || strcmp(entry->line, line) != 0){
+        cacheMisses++;
+        return NULL;
+    }
+
+    cacheHits++;
+    *wantsBackground = entry->wants_background;
+    return entry->tree;
+}
+
+/***************************************************************
+ * cache_store
+ * Parameters: char *line, cmd_node *tree, int wantsBackground
+ * Saves tree as the parse of the raw line, replacing whatever
+ * line shared its slot. The cache takes ownership of tree and
+ * returns 0, or returns -1 if memory could not be allocated.
+****************************************************************/
+int cache_store(char *line, cmd_node *tree, int wantsBackground){
+    cache_entry *entry = &cache[hash_line(line) % CACHE_SLOTS];
+    char *copy = strdup(line);
+
+    if (copy == NULL){
+        return -1;
+    }
+
+    free(entry->line);
+    free_tree(entry->tree);
+    entry->line = copy;
+    entry->tree = tree;
+    entry->wants_background = wantsBackground;
+    return 0;
+}
+
+/***************************************************************
+ * cache_stats
+ * Parameters: none
+ * Displays parse cache hit and miss counters
+****************************************************************/
+void cache_stats(void){
+    int used = 0, i;
+
+    for (i = 0; i < CACHE_SLOTS; i++){
+        used += (cache[i].line != NULL);
+    }
+
+    printf("parse cache: %ld hits, %ld misses, %d of %d slots used\n",
+        cacheHits, cacheMisses, used, CACHE_SLOTS);
+    fflush(stdout);
+}
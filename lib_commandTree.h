@@ -0,0 +1,34 @@
+#ifndef LIB_COMMANDTREE_H_INCLUDED
+#define LIB_COMMANDTREE_H_INCLUDED
+
+#define NODE_SIMPLE 0 // words run as a builtin or program
+#define NODE_SUBSHELL 1 // ( list ) run in a forked copy of the shell
+#define NODE_GROUP 2 // { list; } run in the current shell
+#define NODE_FOR 3 // for var in words; do list; done
+#define NODE_WHILE 4 // while list; do list; done
+
+#define WORD_VARS 1 // word_flags bit, word has $NAME references
+#define WORD_GLOB 2 // word_flags bit, word has pathname patterns
+
+#define CACHE_SLOTS 256 // parsed lines kept by cache_lookup
+
+typedef struct cmd_node {
+    int type;
+    char **words; // NULL terminated words of a simple command or for list
+    unsigned char *word_flags; // WORD_ bits saying how each word expands
+    int num_words;
+    char *var; // variable set by a for loop
+    char *in_file; // < redirection, NULL if none
+    char *out_file; // > redirection, NULL if none
+    struct cmd_node *cond; // condition list of a while loop
+    struct cmd_node *body; // list run by a subshell, group or loop
+    struct cmd_node *next; // next command in a ; separated list
+} cmd_node;
+
+cmd_node *parse_line(char *);
+void free_tree(cmd_node *);
+cmd_node *cache_lookup(char *, int *);
+int cache_store(char *, cmd_node *, int);
+void cache_stats(void);
+
+#endif
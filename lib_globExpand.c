@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "lib_globExpand.h"
+
+#define DIR_BUFFER_SIZE (256 * 1024) // bytes of directory entries per read
+
+extern char **environ;
+
+typedef struct expansion {
+    char ***args; // argv being expanded into
+    int *total; // number of used argv slots
+    int cap; // allocated argv slots
+    long bytes; // bytes of argv and environment used so far
+    long limit; // most bytes exec will accept
+    int failed; // boolean, expansion exceeded limit or memory
+    int dir_only; // boolean, word ends in / so only directories match last
+} expansion;
+
+#ifdef SYS_getdents64
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+static void expand_path(expansion *, char *, char **, int, int);
+
+
+/***************************************************************
+ * has_glob
+ * Parameters: char *word
+ * Returns 1 if word contains *, ? or a [...] bracket expression
+ * that needs pathname expansion, otherwise 0.
+****************************************************************/
+int has_glob(char *word){
+    int i;
+
+    for (i = 0; word[i] != '\0'; i++){
+        if (word[i] == '\\' && word[i+1] != '\0'){
+            i++; // escaped character is never special
+        } else if (word[i] == '*' || word[i] == '?'){
+            return 1;
+        } else if (word[i] == '[' && strchr(word + i + 1, ']') != NULL){
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************
+ * compile_pattern
+ * Parameters: char *text, int len, glob_pattern *pattern
+ * Compiles the first len characters of text into pattern. *
+ * splits the pattern into segments of single character atoms so
+ * match_pattern never has to backtrack. Returns 0 on success or
+ * -1 if memory could not be allocated.
+****************************************************************/
+int compile_pattern(char *text, int len, glob_pattern *pattern){
+    int i = 0, j, negate, c;
+    atom *a;
+
+    pattern->atoms = malloc((len + 1) * sizeof(atom));
+    pattern->seg_start = malloc((len + 2) * sizeof(int));
+    if (pattern->atoms == NULL || pattern->seg_start == NULL){
+        free_pattern(pattern);
+        return -1;
+    }
+
+    pattern->num_atoms = 0;
+    pattern->num_segs = 1;
+    pattern->seg_start[0] = 0;
+    pattern->dot_ok = (len > 0 && text[0] == '.');
+
+    while (i < len){
+
+        // * ends the current segment, repeated * are the same as one
+        if (text[i] == '*'){
+            if (pattern->seg_start[pattern->num_segs-1] != pattern->num_atoms ||
+                pattern->num_segs == 1){
+                pattern->seg_start[pattern->num_segs++] = pattern->num_atoms;
+            }
+            i++;
+            continue;
+        }
+
+        a = &pattern->atoms[pattern->num_atoms++];
+        a->type = ATOM_CHAR;
+
+        if (text[i] == '?'){
+            a->type = ATOM_ANY;
+            i++;
+            continue;
+        }
+
+        if (text[i] == '\\' && i + 1 < len){ // escaped literal
+            a->ch = text[i+1];
+            i += 2;
+            continue;
+        }
+
+        if (text[i] == '['){
+            // find the closing ], a leading ] is part of the set
+            j = i + 1;
+            negate = (j < len && (text[j] == '!' || text[j] == '^'));
+            j += negate;
+            if (j < len && text[j] == ']'){
+                j++;
+            }
+            while (j < len && text[j] != ']'){
+                j++;
+            }
+
+            if (j < len){ // build set bitmap from text[i+1+negate..j)
+                memset(a->set, 0, sizeof(a->set));
+                a->type = ATOM_SET;
+
+                for (i = i + 1 + negate; i < j; i++){
+                    if (i + 2 < j && text[i+1] == '-'){ // range a-z
+                        for (c = (unsigned char)text[i]; c <= (unsigned char)text[i+2]; c++){
+                            a->set[c / 8] |= 1 << (c % 8);
+                        }
+                        i += 2;
+                    } else {
+                        c = (unsigned char)text[i];
+                        a->set[c / 8] |= 1 << (c % 8);
+                    }
+                }
+
+                if (negate){
+                    for (c = 0; c < 32; c++){
+                        a->set[c] = ~a->set[c];
+                    }
+                }
+
+                i = j + 1;
+                continue;
+            }
+        }
+
+        a->ch = text[i]; // plain character, including an unclosed [
+        i++;
+    }
+
+    pattern->seg_start[pattern->num_segs] = pattern->num_atoms;
+    return 0;
+}
+
+/***************************************************************
+ * match_segment
+ * Parameters: glob_pattern *pattern, int seg, char *name
+ * Returns 1 if segment seg matches the characters at name.
+ * Caller ensures name has enough characters left.
+****************************************************************/
+static int match_segment(glob_pattern *pattern, int seg, char *name){
+    int i, c;
+    atom *a;
+
+    for (i = pattern->seg_start[seg]; i < pattern->seg_start[seg+1]; i++){
+        a = &pattern->atoms[i];
+        c = (unsigned char)*name++;
+
+        if (a->type == ATOM_CHAR && a->ch != c){
+            return 0;
+        }
+        if (a->type == ATOM_SET && (a->set[c / 8] & (1 << (c % 8))) == 0){
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/***************************************************************
+ * match_pattern
+ * Parameters: glob_pattern *pattern, char *name, int len
+ * Returns 1 if name matches pattern. The first segment must match
+ * at the start and the last at the end. Middle segments are
+ * matched at their leftmost position, which is always safe for
+ * * wildcards, so each character is examined a bounded number of
+ * times instead of backtracking.
+****************************************************************/
+int match_pattern(glob_pattern *pattern, char *name, int len){
+    int last = pattern->num_segs - 1, seg, segLen, pos, end;
+    int firstLen = pattern->seg_start[1] - pattern->seg_start[0];
+    int lastLen = pattern->seg_start[last+1] - pattern->seg_start[last];
+    atom *lead;
+
+    // hidden names only match patterns that start with .
+    if (name[0] == '.' && pattern->dot_ok == 0){
+        return 0;
+    }
+
+    // no * at all, lengths must agree exactly
+    if (last == 0){
+        return (len == firstLen && match_segment(pattern, 0, name));
+    }
+
+    if (firstLen + lastLen > len || match_segment(pattern, 0, name) == 0 ||
+        match_segment(pattern, last, name + len - lastLen) == 0){
+        return 0;
+    }
+
+    pos = firstLen;
+    end = len - lastLen;
+
+    for (seg = 1; seg < last; seg++){
+        segLen = pattern->seg_start[seg+1] - pattern->seg_start[seg];
+        lead = &pattern->atoms[pattern->seg_start[seg]];
+
+        while (pos + segLen <= end){
+            // jump straight to candidates for a literal first character
+            if (lead->type == ATOM_CHAR){
+                char *next = memchr(name + pos, lead->ch, end - segLen - pos + 1);
+                if (next == NULL){
+                    return 0;
+                }
+                pos = next - name;
+            }
+
+            if (match_segment(pattern, seg, name + pos)){
+                break;
+            }
+            pos++;
+        }
+
+        if (pos + segLen > end){
+            return 0;
+        }
+        pos += segLen;
+    }
+
+    return 1;
+}
+
+/***************************************************************
+ * free_pattern
+ * Parameters: glob_pattern *pattern
+ * Free's the memory of a compiled pattern
+****************************************************************/
+void free_pattern(glob_pattern *pattern){
+    free(pattern->atoms);
+    free(pattern->seg_start);
+    pattern->atoms = NULL;
+    pattern->seg_start = NULL;
+}
+
+/***************************************************************
+ * add_match
+ * Parameters: expansion *ex, char *path
+ * Appends path to the argv being expanded, growing it in
+ * doubling steps. Marks the expansion failed instead once the
+ * arguments would no longer fit in exec's limit.
+****************************************************************/
+static void add_match(expansion *ex, char *path){
+    long size = strlen(path) + 1 + sizeof(char *);
+    char **grown;
+
+    if (ex->bytes + size > ex->limit){
+        ex->failed = 1;
+        free(path);
+        return;
+    }
+
+    if (*ex->total + 1 >= ex->cap){
+        ex->cap *= 2;
+        grown = realloc(*ex->args, ex->cap * sizeof(char *));
+        if (grown == NULL){
+            ex->failed = 1;
+            free(path);
+            return;
+        }
+        *ex->args = grown;
+    }
+
+    (*ex->args)[(*ex->total)++] = path;
+    ex->bytes += size;
+}
+
+/***************************************************************
+ * join_path
+ * Parameters: char *prefix, char *name, int slash
+ * Returns a newly allocated prefix + name, followed by / when
+ * slash is 1.
+****************************************************************/
+static char *join_path(char *prefix, char *name, int slash){
+    int prefixLen = strlen(prefix), nameLen = strlen(name);
+    char *path = malloc(prefixLen + nameLen + 2);
+
+    if (path != NULL){
+        memcpy(path, prefix, prefixLen);
+        memcpy(path + prefixLen, name, nameLen);
+        path[prefixLen + nameLen] = '/';
+        path[prefixLen + nameLen + slash] = '\0';
+    }
+
+    return path;
+}
+
+/***************************************************************
+ * consider_entry
+ * Parameters: expansion *ex, char *prefix, char *name, int type,
+ * char **comps, int numComps, int idx
+ * Handles a directory entry that matched component idx. The last
+ * component adds the path, otherwise expansion continues inside
+ * the entry if it is a directory. When the word ended in / the
+ * last component only adds directories, with the / kept.
+****************************************************************/
+static void consider_entry(expansion *ex, char *prefix, char *name, int type,
+                           char **comps, int numComps, int idx){
+    int last = (idx == numComps - 1);
+    struct stat info;
+    char *path;
+
+    path = join_path(prefix, name, last == 0 || ex->dir_only == 1);
+    if (path == NULL){
+        ex->failed = 1;
+        return;
+    }
+
+    if (last == 1 && ex->dir_only == 0){
+        add_match(ex, path);
+        return;
+    }
+
+    // only directories go on, following symlinks
+    if (type != DT_DIR && ((type != DT_LNK && type != DT_UNKNOWN) ||
+        stat(path, &info) == -1 || !S_ISDIR(info.st_mode))){
+        free(path);
+        return;
+    }
+
+    if (last == 1){
+        add_match(ex, path);
+        return;
+    }
+
+    expand_path(ex, path, comps, numComps, idx + 1);
+    free(path);
+}
+
+/***************************************************************
+ * expand_path
+ * Parameters: expansion *ex, char *prefix, char **comps,
+ * int numComps, int idx
+ * Expands path component idx inside directory prefix. Literal
+ * components are appended without reading the directory. Other
+ * components are matched against the directory in large batches
+ * with getdents64 so only matching names are ever kept.
+****************************************************************/
+static void expand_path(expansion *ex, char *prefix, char **comps, int numComps, int idx){
+    glob_pattern pattern;
+    struct stat info;
+    char *path, *name;
+    int fd;
+
+    if (ex->failed == 1){
+        return;
+    }
+
+    // literal component, keep it only if it exists
+    if (has_glob(comps[idx]) == 0){
+        path = join_path(prefix, comps[idx], idx < numComps - 1 || ex->dir_only == 1);
+        if (path == NULL){
+            ex->failed = 1;
+        } else if (idx == numComps - 1){
+            if ((ex->dir_only == 0 && lstat(path, &info) == 0) ||
+                (ex->dir_only == 1 && stat(path, &info) == 0 && S_ISDIR(info.st_mode))){
+                add_match(ex, path);
+                return;
+            }
+        } else {
+            expand_path(ex, path, comps, numComps, idx + 1);
+        }
+        free(path);
+        return;
+    }
+
+    fd = open((prefix[0] == '\0') ? "." : prefix, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1){ // unreadable directories have no matches
+        return;
+    }
+
+    if (compile_pattern(comps[idx], strlen(comps[idx]), &pattern) == -1){
+        ex->failed = 1;
+        close(fd);
+        return;
+    }
+
+#ifdef SYS_getdents64
+    char *buffer = malloc(DIR_BUFFER_SIZE);
+    struct linux_dirent64 *entry;
+    long nread, offset;
+
+    while (buffer != NULL && ex->failed == 0 &&
+           (nread = syscall(SYS_getdents64, fd, buffer, DIR_BUFFER_SIZE)) > 0){
+        for (offset = 0; offset < nread; offset += entry->d_reclen){
+            entry = (struct linux_dirent64 *)(buffer + offset);
+            name = entry->d_name;
+
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0){
+                continue;
+            }
+            if (match_pattern(&pattern, name, strlen(name))){
+                consider_entry(ex, prefix, name, entry->d_type, comps, numComps, idx);
+            }
+        }
+    }
+
+    if (buffer == NULL){
+        ex->failed = 1;
+    }
+    free(buffer);
+    close(fd);
+#else
+    DIR *dir = fdopendir(fd);
+    struct dirent *entry;
+
+    while (dir != NULL && ex->failed == 0 && (entry = readdir(dir)) != NULL){
+        name = entry->d_name;
+
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0){
+            continue;
+        }
+        if (match_pattern(&pattern, name, strlen(name))){
+            consider_entry(ex, prefix, name, entry->d_type, comps, numComps, idx);
+        }
+    }
+
+    if (dir != NULL){
+        closedir(dir);
+    } else {
+        close(fd);
+    }
+#endif
+
+    free_pattern(&pattern);
+}
+
+/***************************************************************
+ * compare_args
+ * Parameters: const void *a, const void *b
+ * qsort comparison for sorting expanded paths
+****************************************************************/
+static int compare_args(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/***************************************************************
+ * glob_expand
+ * Parameters: char *word, char ***args, int *total
+ * Expands word as a pathname pattern and appends the sorted
+ * matches to args, keeping args NULL terminated and total up to
+ * date. Returns the number of matches added, 0 if nothing
+ * matched (word should be used as is), or -1 if the matches do
+ * not fit in exec's argument limit or memory ran out.
+****************************************************************/
+int glob_expand(char *word, char ***args, int *total){
+    expansion ex;
+    char *copy = strdup(word), *remaining, *comp, *prefix = "";
+    char **comps = NULL, **grown;
+    int numComps = 0, first = *total, i;
+
+    if (copy == NULL){
+        return -1;
+    }
+
+    ex.args = args;
+    ex.total = total;
+    ex.cap = *total + 1;
+    ex.limit = arg_limit();
+    ex.failed = 0;
+    ex.dir_only = (word[0] != '\0' && word[strlen(word) - 1] == '/');
+    ex.bytes = sizeof(char *);
+    for (i = 0; i < *total; i++){
+        ex.bytes += strlen((*args)[i]) + 1 + sizeof(char *);
+    }
+
+    // split pattern into / separated components
+    if (word[0] == '/'){
+        prefix = "/";
+    }
+    comp = strtok_r(copy, "/", &remaining);
+    while (comp != NULL){
+        grown = realloc(comps, (numComps + 1) * sizeof(char *));
+        if (grown == NULL){
+            ex.failed = 1;
+            break;
+        }
+        comps = grown;
+        comps[numComps++] = comp;
+        comp = strtok_r(NULL, "/", &remaining);
+    }
+
+    if (numComps > 0 && ex.failed == 0){
+        expand_path(&ex, prefix, comps, numComps, 0);
+    }
+    free(comps);
+    free(copy);
+
+    if (ex.failed == 1){ // drop partial results
+        for (i = first; i < *total; i++){
+            free((*args)[i]);
+        }
+        *total = first;
+        (*args)[first] = NULL;
+
+        printf("Argument list too long: %s expands past %ld bytes\n", word, ex.limit);
+        fflush(stdout);
+        return -1;
+    }
+
+    qsort(*args + first, *total - first, sizeof(char *), compare_args);
+
+    // trim to size and keep args NULL terminated
+    grown = realloc(*args, (*total + 1) * sizeof(char *));
+    if (grown != NULL){
+        *args = grown;
+    }
+    (*args)[*total] = NULL;
+
+    return *total - first;
+}
+
+/***************************************************************
+ * arg_limit
+ * Parameters: none
+ * Returns the number of bytes available to argv, which is
+ * ARG_MAX less what the environment already uses and a little
+ * headroom for the exec stack.
+****************************************************************/
+long arg_limit(void){
+    long limit = sysconf(_SC_ARG_MAX);
+
+    if (limit <= 0){
+        limit = 131072;
+    }
+
+    return limit - arg_bytes(environ) - 2048;
+}
+
+/***************************************************************
+ * arg_bytes
+ * Parameters: char **args
+ * Returns the bytes exec needs for the NULL terminated args,
+ * counting each string and its pointer.
+****************************************************************/
+long arg_bytes(char **args){
+    long bytes = sizeof(char *);
+
+    while (args != NULL && *args != NULL){
+        bytes += strlen(*args) + 1 + sizeof(char *);
+        args++;
+    }
+
+    return bytes;
+}
+
+/***************************************************************
+ * args_fit
+ * Parameters: char **args
+ * Returns 1 if exec will accept args. Otherwise displays which
+ * limit was exceeded and returns 0, so an oversized argv is
+ * reported before fork instead of failing with E2BIG.
+****************************************************************/
+int args_fit(char **args){
+    long bytes = arg_bytes(args), limit = arg_limit();
+    int i;
+
+    if (bytes > limit){
+        printf("Argument list too long for %s: %ld bytes exceeds limit of %ld\n",
+            args[0], bytes, limit);
+        fflush(stdout);
+        return 0;
+    }
+
+    for (i = 0; args[i] != NULL; i++){
+        if (strlen(args[i]) >= MAX_ARG_LENGTH){
+            printf("Argument %d for %s is too long: %ld bytes exceeds limit of %d\n",
+                i, args[0], (long)strlen(args[i]), MAX_ARG_LENGTH - 1);
+            fflush(stdout);
+            return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef LIB_GLOBEXPAND_H_INCLUDED
+#define LIB_GLOBEXPAND_H_INCLUDED
+
+#define MAX_ARG_LENGTH (32 * 4096) // longest single argument Linux accepts
+
+#define ATOM_CHAR 0 // matches ch exactly
+#define ATOM_ANY 1 // ? matches any single character
+#define ATOM_SET 2 // [...] matches any character in set
+
+typedef struct atom {
+    int type;
+    unsigned char ch;
+    unsigned char set[32]; // bitmap of 256 characters for ATOM_SET
+} atom;
+
+typedef struct glob_pattern {
+    atom *atoms; // every atom of the pattern with * removed
+    int *seg_start; // index into atoms where each * separated segment begins
+    int num_segs; // number of segments, one more than the number of *
+    int num_atoms;
+    int dot_ok; // boolean, pattern may match names starting with .
+} glob_pattern;
+
+int has_glob(char *);
+int compile_pattern(char *, int, glob_pattern *);
+int match_pattern(glob_pattern *, char *, int);
+void free_pattern(glob_pattern *);
+int glob_expand(char *, char ***, int *);
+long arg_limit(void);
+long arg_bytes(char **);
+int args_fit(char **);
+
+#endif
@@ -0,0 +1,453 @@
+#define _GNU_SOURCE // pipe2
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include "lib_jobOutput.h"
+
+#define READ_CHUNK 16384 // bytes read from a pipe at a time
+#define READS_PER_DRAIN 16 // most chunks taken from one pipe per wake up
+
+static job_output *captures = NULL; // oldest first
+static long budgetUsed = 0; // bytes of ring buffers allocated
+static int logFD = -1; // spill log, -1 if disabled
+static char *logPath = NULL;
+static long logMax = LOG_MAX_BYTES, logSize = 0;
+
+
+/***************************************************************
+ * capture_pipe
+ * Parameters: int *fds
+ * Creates the pipe a background process writes its output to.
+ * The read end is non-blocking so the shell never stalls on it,
+ * and both ends are close-on-exec so other processes do not
+ * inherit them. Returns 0 on success or -1.
+****************************************************************/
+int capture_pipe(int *fds){
+
+    if (pipe2(fds, O_CLOEXEC) == -1){
+        return -1;
+    }
+
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+/***************************************************************
+ * free_capture
+ * Parameters: job_output *job
+ * Closes the pipe of job and free's its memory and budget
+****************************************************************/
+static void free_capture(job_output *job){
+
+    if (job->fd != -1){
+        close(job->fd);
+    }
+    budgetUsed -= job->buf.size;
+    free(job->buf.data);
+    free(job->command);
+    free(job);
+}
+
+/***************************************************************
+ * evict_finished
+ * Parameters: none
+ * Free's the output of the oldest finished process. Returns 1 if
+ * one was evicted, 0 if no process has finished.
+****************************************************************/
+static int evict_finished(void){
+    job_output **link = &captures, *found;
+
+    while (*link != NULL && (*link)->finished == 0){
+        link = &(*link)->next;
+    }
+
+    if (*link == NULL){
+        return 0;
+    }
+
+    found = *link;
+    *link = found->next;
+    free_capture(found);
+    return 1;
+}
+
+/***************************************************************
+ * capture_track
+ * Parameters: int pid, int fd, char *command
+ * Starts keeping the output pid writes to the pipe read end fd.
+ * Output of finished processes is evicted, oldest first, to keep
+ * all buffers within OUTPUT_BUDGET. If the budget is still used
+ * up by running processes, pid gets no buffer and its output is
+ * only counted (and spilled to the log if one is enabled).
+****************************************************************/
+void capture_track(int pid, int fd, char *command){
+    job_output *job, **tail = &captures;
+    int finished = 0;
+    long size;
+
+    // keep a bounded number of finished processes around
+    for (job = captures; job != NULL; job = job->next){
+        finished += job->finished;
+    }
+    while (finished >= MAX_FINISHED && evict_finished() == 1){
+        finished--;
+    }
+
+    while (budgetUsed + RING_SIZE > OUTPUT_BUDGET && evict_finished() == 1){
+        continue;
+    }
+
+    job = calloc(1, sizeof(job_output));
+    if (job == NULL){
+        printf("Unable to allocate memory to capture output of PID %d\n", pid);
+        fflush(stdout);
+        close(fd);
+        return;
+    }
+
+    size = OUTPUT_BUDGET - budgetUsed;
+    size = (size > RING_SIZE) ? RING_SIZE : size;
+    job->buf.data = (size > 0) ? malloc(size) : NULL;
+    job->buf.size = (job->buf.data != NULL) ? size : 0;
+    budgetUsed += job->buf.size;
+
+    job->pid = pid;
+    job->fd = fd;
+    job->line_start = 1;
+    job->command = strdup(command);
+
+    while (*tail != NULL){
+        tail = &(*tail)->next;
+    }
+    *tail = job;
+}
+
+/***************************************************************
+ * ring_write
+ * Parameters: ring *buf, char *data, long len
+ * Appends data to buf, overwriting the oldest bytes once full
+****************************************************************/
+static void ring_write(ring *buf, char *data, long len){
+    long end, first;
+
+    buf->total += len;
+    if (buf->size == 0){
+        return;
+    }
+
+    // only the newest size bytes can survive
+    if (len >= buf->size){
+        memcpy(buf->data, data + len - buf->size, buf->size);
+        buf->start = 0;
+        buf->used = buf->size;
+        return;
+    }
+
+    end = (buf->start + buf->used) % buf->size;
+    first = (end + len > buf->size) ? buf->size - end : len;
+    memcpy(buf->data + end, data, first);
+    memcpy(buf->data, data + first, len - first);
+
+    if (buf->used + len > buf->size){
+        buf->start = (buf->start + buf->used + len - buf->size) % buf->size;
+        buf->used = buf->size;
+    } else {
+        buf->used += len;
+    }
+}
+
+/***************************************************************
+ * rotate_log
+ * Parameters: none
+ * Renames the spill log to PATH.1 and starts an empty one
+****************************************************************/
+static void rotate_log(void){
+    char *rotated = malloc(strlen(logPath) + 3);
+
+    if (rotated != NULL){
+        sprintf(rotated, "%s.1", logPath);
+        rename(logPath, rotated);
+        free(rotated);
+    }
+    close(logFD);
+    logFD = open(logPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    logSize = 0;
+}
+
+/***************************************************************
+ * spill_write
+ * Parameters: job_output *job, char *data, long len
+ * Appends data to the spill log, if enabled, with every line
+ * prefixed by the pid that wrote it. The log is rotated to
+ * PATH.1 before a line would take it past logMax bytes. A line
+ * longer than logMax is split, each part with its own prefix.
+****************************************************************/
+static void spill_write(job_output *job, char *data, long len){
+    char prefix[32], *newline;
+    long line, prefixLen, need;
+
+    prefixLen = snprintf(prefix, sizeof(prefix), "[%d] ", job->pid);
+
+    while (len > 0 && logFD != -1){
+        newline = memchr(data, '\n', len);
+        line = (newline == NULL) ? len : newline - data + 1;
+        need = (job->line_start == 1) ? prefixLen : 0;
+
+        if (logSize > 0 && logSize + need + line > logMax){
+            rotate_log();
+            job->line_start = 1; // every log starts on a prefix
+            continue;
+        }
+
+        // too long for an empty log, write what fits
+        if (need + line > logMax){
+            line = (logMax > need) ? logMax - need : 1;
+            newline = NULL;
+        }
+
+        if (need > 0 && write(logFD, prefix, prefixLen) > 0){
+            logSize += prefixLen;
+        }
+        if (write(logFD, data, line) > 0){
+            logSize += line;
+        }
+
+        job->line_start = (newline != NULL);
+        data += line;
+        len -= line;
+    }
+}
+
+/***************************************************************
+ * capture_read
+ * Parameters: job_output *job
+ * Reads whatever job's pipe holds without blocking. A bounded
+ * number of chunks is taken per call so one chatty process
+ * cannot keep the shell from its other work. Closes the pipe at
+ * end of file.
+****************************************************************/
+static void capture_read(job_output *job){
+    char chunk[READ_CHUNK];
+    ssize_t len;
+    int reads;
+
+    for (reads = 0; job->fd != -1 && reads < READS_PER_DRAIN; reads++){
+        len = read(job->fd, chunk, sizeof(chunk));
+
+        if (len > 0){
+            ring_write(&job->buf, chunk, len);
+            spill_write(job, chunk, len);
+        } else if (len == 0 || (errno != EAGAIN && errno != EINTR)){
+            close(job->fd);
+            job->fd = -1;
+        } else {
+            break; // nothing left for now
+        }
+    }
+}
+
+/***************************************************************
+ * capture_finish
+ * Parameters: int pid, int childStatus
+ * Marks the output of pid as finished once pid is reaped and
+ * collects what is left in its pipe. The pipe stays open until
+ * end of file in case pid left children writing to it.
+****************************************************************/
+void capture_finish(int pid, int childStatus){
+    job_output *job;
+
+    for (job = captures; job != NULL; job = job->next){
+        if (job->pid == pid && job->finished == 0){
+            job->finished = 1;
+            job->status = childStatus;
+            capture_read(job);
+            return;
+        }
+    }
+}
+
+/***************************************************************
+ * capture_count
+ * Parameters: none
+ * Returns the number of pipes still open
+****************************************************************/
+int capture_count(void){
+    job_output *job;
+    int total = 0;
+
+    for (job = captures; job != NULL; job = job->next){
+        total += (job->fd != -1);
+    }
+    return total;
+}
+
+/***************************************************************
+ * capture_pollfds
+ * Parameters: struct pollfd *fds, int max
+ * Fills up to max entries of fds with the open pipes. Returns
+ * the number of entries filled.
+****************************************************************/
+int capture_pollfds(struct pollfd *fds, int max){
+    job_output *job;
+    int total = 0;
+
+    for (job = captures; job != NULL && total < max; job = job->next){
+        if (job->fd != -1){
+            fds[total].fd = job->fd;
+            fds[total].events = POLLIN;
+            fds[total].revents = 0;
+            total++;
+        }
+    }
+    return total;
+}
+
+/***************************************************************
+ * capture_drain
+ * Parameters: struct pollfd *fds, int nfds
+ * Reads from every pipe poll reported as readable or closed
+****************************************************************/
+void capture_drain(struct pollfd *fds, int nfds){
+    job_output *job;
+    int i;
+
+    for (i = 0; i < nfds; i++){
+        if (fds[i].revents == 0){
+            continue;
+        }
+        for (job = captures; job != NULL; job = job->next){
+            if (job->fd == fds[i].fd){
+                capture_read(job);
+                break;
+            }
+        }
+    }
+}
+
+/***************************************************************
+ * capture_reset
+ * Parameters: none
+ * Closes every pipe and the spill log and free's all kept output.
+ * Used by forked copies of the shell, which must leave draining
+ * to the original.
+****************************************************************/
+void capture_reset(void){
+    job_output *next;
+
+    while (captures != NULL){
+        next = captures->next;
+        free_capture(captures);
+        captures = next;
+    }
+
+    if (logFD != -1){
+        close(logFD);
+        logFD = -1;
+    }
+}
+
+/***************************************************************
+ * print_tail
+ * Parameters: job_output *job
+ * Displays the output kept for job
+****************************************************************/
+static void print_tail(job_output *job){
+    ring *buf = &job->buf;
+    long first = (buf->start + buf->used > buf->size) ? buf->size - buf->start : buf->used;
+
+    printf("PID %d (%s): last %ld of %lld bytes\n", job->pid, job->command, buf->used, buf->total);
+    fflush(stdout);
+
+    if (buf->used == 0){
+        return;
+    }
+
+    fwrite(buf->data + buf->start, 1, first, stdout);
+    fwrite(buf->data, 1, buf->used - first, stdout);
+
+    // finish an unterminated last line before the next prompt
+    if (buf->data[(buf->start + buf->used - 1) % buf->size] != '\n'){
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+/***************************************************************
+ * jobs_command
+ * Parameters: char **args, int total
+ * jobs lists background processes with kept output. jobs -o PID
+ * displays the output kept for PID. jobs -l PATH [MAXBYTES]
+ * also appends all output to the log PATH, rotating it at
+ * MAXBYTES. jobs -l alone stops logging. Returns 0 on success
+ * or 1.
+****************************************************************/
+int jobs_command(char **args, int total){
+    job_output *job;
+    int pid;
+
+    if (total == 1){
+        for (job = captures; job != NULL; job = job->next){
+            printf("PID %d ", job->pid);
+            if (job->finished == 0){
+                printf("running");
+            } else if (WIFEXITED(job->status)){
+                printf("exited with value %d", WEXITSTATUS(job->status));
+            } else {
+                printf("terminated by signal %d", WTERMSIG(job->status));
+            }
+            printf(", %lld bytes of output: %s\n", job->buf.total, job->command);
+        }
+        fflush(stdout);
+        return 0;
+    }
+
+    if (strcmp(args[1], "-o") == 0 && total == 3){
+        pid = atoi(args[2]);
+        for (job = captures; job != NULL; job = job->next){
+            if (job->pid == pid){
+                print_tail(job);
+                return 0;
+            }
+        }
+        printf("jobs: no output kept for %s\n", args[2]);
+        fflush(stdout);
+        return 1;
+    }
+
+    if (strcmp(args[1], "-l") == 0 && total <= 4){
+        if (logFD != -1){
+            close(logFD);
+            logFD = -1;
+        }
+        free(logPath);
+        logPath = NULL;
+
+        if (total == 2){ // logging off
+            return 0;
+        }
+
+        logMax = (total == 4) ? atol(args[3]) : LOG_MAX_BYTES;
+        logMax = (logMax > 0) ? logMax : LOG_MAX_BYTES;
+        logPath = strdup(args[2]);
+        logFD = open(args[2], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (logPath == NULL || logFD == -1){
+            printf("Unable to open %s for job output\n", args[2]);
+            fflush(stdout);
+            if (logFD != -1){
+                close(logFD);
+                logFD = -1;
+            }
+            return 1;
+        }
+        logSize = lseek(logFD, 0, SEEK_END);
+        return 0;
+    }
+
+    printf("Usage: jobs [-o PID] [-l [PATH [MAXBYTES]]]\n");
+    fflush(stdout);
+    return 1;
+}
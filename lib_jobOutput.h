@@ -0,0 +1,39 @@
+#ifndef LIB_JOBOUTPUT_H_INCLUDED
+#define LIB_JOBOUTPUT_H_INCLUDED
+
+#include <poll.h>
+
+#define RING_SIZE (64 * 1024) // bytes of output kept per background process
+#define OUTPUT_BUDGET (1024 * 1024) // bytes of output kept for all of them
+#define MAX_FINISHED 32 // finished processes whose output is kept
+#define LOG_MAX_BYTES (1024 * 1024) // default size before the spill log rotates
+
+typedef struct ring {
+    char *data;
+    long size; // capacity of data, 0 if the budget was used up
+    long start; // index of the oldest byte
+    long used; // bytes currently held
+    long long total; // bytes ever written
+} ring;
+
+typedef struct job_output {
+    int pid;
+    int fd; // read end of the process's stdout/stderr pipe, -1 at EOF
+    int finished; // boolean, process has been reaped
+    int status; // wait status once finished
+    int line_start; // boolean, next byte begins a line in the spill log
+    char *command;
+    ring buf;
+    struct job_output *next;
+} job_output;
+
+int capture_pipe(int *);
+void capture_track(int, int, char *);
+void capture_finish(int, int);
+int capture_pollfds(struct pollfd *, int);
+void capture_drain(struct pollfd *, int);
+int capture_count(void);
+void capture_reset(void);
+int jobs_command(char **, int);
+
+#endif
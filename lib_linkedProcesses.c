@@ -3,6 +3,8 @@
 #include<stdlib.h>
 #include<string.h>
 #include<signal.h>
+#include<unistd.h>
+#include<time.h>
 #include "lib_linkedProcesses.h"
 
 
@@ -10,17 +12,25 @@
  * add_node
  * Parameters: LinkedList *head, int childPID
  * Creates a node with ChildPID as data and adds to end of
- * linked list
+ * linked list. Returns the node's data so callers can fill in
+ * any tracking fields, or NULL if memory could not be allocated.
 ****************************************************************/
-void add_node(LinkedList *head, int childPID){
+Proc_info *add_node(LinkedList *head, int childPID){
     // create new node with childPID 
     Proc_info *new_add = malloc(sizeof(Proc_info));
     if ( new_add == NULL){
         printf("Unable to allocate memory to add to linked list\n");
         fflush(stdout);
-        return;
+        return NULL;
     }
     new_add->pid = childPID;
+    new_add->pidfd = -1;
+    new_add->deadline = -1;
+    new_add->kill_after = 0;
+    new_add->term_sent = 0;
+    new_add->timed_out = 0;
+    new_add->command = NULL;
+    new_add->start_ms = 0;
 
     // insert as first if list empty
     if (*head == NULL){
@@ -40,6 +50,56 @@ void add_node(LinkedList *head, int childPID){
         newNode->next = NULL;
         last->next = newNode;
     }
+
+    return new_add;
+}
+
+/***************************************************************
+ * find_node
+ * Parameters: LinkedList current, int childPID
+ * Returns the data of the node tracking childPID, or NULL if
+ * childPID is not in the list.
+****************************************************************/
+Proc_info *find_node(LinkedList current, int childPID){
+
+    while (current != NULL) {
+        if (current->data->pid == childPID){
+            return current->data;
+        }
+        current = current->next;
+    }
+
+    return NULL;
+}
+
+/***************************************************************
+ * remove_node
+ * Parameters: LinkedList *head, int childPID
+ * Unlinks the node tracking childPID, closes its pidfd and
+ * free's its memory.
+ * Does nothing if childPID is not in the list.
+****************************************************************/
+void remove_node(LinkedList *head, int childPID){
+    LinkedList *link = head;
+    LinkedList found;
+
+    // walk the next pointers so the head needs no special case
+    while (*link != NULL && (*link)->data->pid != childPID) {
+        link = &(*link)->next;
+    }
+
+    if (*link == NULL){
+        return;
+    }
+
+    found = *link;
+    *link = found->next;
+    if (found->data->pidfd != -1){
+        close(found->data->pidfd);
+    }
+    free(found->data->command);
+    free(found->data);
+    free(found);
 }
 
 /***************************************************************
@@ -67,6 +127,22 @@ void print_linked_proc(LinkedList current){
 
 }
 
+/***************************************************************
+ * count_nodes
+ * Parameters: LinkedList current
+ * Returns the number of tracked processes
+****************************************************************/
+int count_nodes(LinkedList current){
+    int total = 0;
+
+    while (current != NULL) {
+        total++;
+        current = current->next;
+    }
+
+    return total;
+}
+
 /***************************************************************
  * kill_processes
  * Parameters: LinkedList current
@@ -90,6 +166,7 @@ void kill_processes(LinkedList current){
  * free_linked_proc
  * Parameters: LinkedList *head
  * Cycles through list and free's memory for data and next pointers
+ * after closing any pidfds
 ****************************************************************/
 void free_linked_proc(LinkedList *head){
 
@@ -100,8 +177,98 @@ void free_linked_proc(LinkedList *head){
     LinkedList temp;
     while (*head != NULL) {
         temp = (*head)->next;
+        if ((*head)->data->pidfd != -1){
+            close((*head)->data->pidfd);
+        }
+        free((*head)->data->command);
         free((*head)->data);
         free(*head);
         (*head) = temp;
     }
 }
+
+/***************************************************************
+ * monotonic_ms
+ * Parameters: none
+ * Returns the monotonic clock in milliseconds. Used for job
+ * deadlines so wall clock changes do not shorten or extend them.
+****************************************************************/
+long long monotonic_ms(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/***************************************************************
+ * wall_ms
+ * Parameters: none
+ * Returns the wall clock in ms since the epoch, for reporting
+ * when a job started
+****************************************************************/
+long long wall_ms(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/***************************************************************
+ * monotonic_us
+ * Parameters: none
+ * Returns the monotonic clock in microseconds, for timing forks
+****************************************************************/
+long long monotonic_us(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/***************************************************************
+ * next_deadline
+ * Parameters: LinkedList current
+ * Returns the earliest pending deadline among tracked processes,
+ * or -1 if none of them have one.
+****************************************************************/
+long long next_deadline(LinkedList current){
+    long long earliest = -1;
+
+    while (current != NULL) {
+        if (current->data->deadline >= 0 &&
+            (earliest < 0 || current->data->deadline < earliest)){
+            earliest = current->data->deadline;
+        }
+        current = current->next;
+    }
+
+    return earliest;
+}
+
+/***************************************************************
+ * enforce_deadlines
+ * Parameters: LinkedList current
+ * Sends SIGTERM to every tracked process whose deadline has
+ * passed and re-arms the deadline for its grace period. If the
+ * grace period also passes, the process is sent SIGKILL.
+****************************************************************/
+void enforce_deadlines(LinkedList current){
+    long long now = monotonic_ms();
+
+    while (current != NULL) {
+        Proc_info *job = current->data;
+
+        if (job->deadline >= 0 && job->deadline <= now){
+            if (job->term_sent == 0){ // first strike, ask politely
+                kill(job->pid, SIGTERM);
+                job->term_sent = 1;
+                job->timed_out = 1;
+                job->deadline = now + job->kill_after;
+            } else { // grace period over
+                kill(job->pid, SIGKILL);
+                job->deadline = -1;
+            }
+        }
+        current = current->next;
+    }
+}
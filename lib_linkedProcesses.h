@@ -5,6 +5,13 @@
 
 typedef struct proc_info{
   int pid;
+  int pidfd; // polls readable when pid exits, -1 if unavailable
+  long long deadline; // monotonic ms to signal the job, -1 if none
+  long long kill_after; // grace period in ms between SIGTERM and SIGKILL
+  int term_sent; // boolean, SIGTERM already delivered
+  int timed_out; // boolean, job was signalled for exceeding its deadline
+  char *command; // command line as entered, NULL if unknown
+  long long start_ms; // wall clock ms since the epoch when started
 } Proc_info;
 
 typedef struct node {
@@ -14,11 +21,18 @@ typedef struct node {
 
 typedef struct node *LinkedList;
 
-void add_node(LinkedList *head, int childPID);
-// void remove_node(LinkedList *head, int childPID);
+Proc_info *add_node(LinkedList *head, int childPID);
+Proc_info *find_node(LinkedList current, int childPID);
+void remove_node(LinkedList *head, int childPID);
 void print_linked_proc(LinkedList current);
+int count_nodes(LinkedList current);
 void kill_processes(LinkedList);
 void free_linked_proc(LinkedList *head);
+long long monotonic_ms(void);
+long long monotonic_us(void);
+long long wall_ms(void);
+long long next_deadline(LinkedList current);
+void enforce_deadlines(LinkedList current);
 
 
 #endif
\ No newline at end of file
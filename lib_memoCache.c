@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "lib_shellCommands.h"
+#include "lib_memoCache.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static long memoHits = 0, memoMisses = 0;
+static long long bytesSaved = 0;
+
+
+/***************************************************************
+ * fnv_add
+ * Parameters: unsigned long long hash, const void *data, size_t len
+ * Folds len bytes of data into a 64 bit FNV-1a hash
+****************************************************************/
+static unsigned long long fnv_add(unsigned long long hash, const void *data, size_t len){
+    const unsigned char *bytes = data;
+
+    while (len-- > 0){
+        hash = (hash ^ *bytes++) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/***************************************************************
+ * add_input
+ * Parameters: unsigned long long hash, char *path, int content
+ * Folds an input file into hash. By default its size, mtime and
+ * inode stand in for its contents. With content set, the bytes
+ * of the file are hashed instead, so a touched but unchanged
+ * file still matches. Missing files hash as missing.
+****************************************************************/
+static unsigned long long add_input(unsigned long long hash, char *path, int content){
+    struct stat info;
+    char chunk[65536];
+    ssize_t len;
+    int fd;
+
+    hash = fnv_add(hash, path, strlen(path) + 1);
+
+    if (stat(path, &info) == -1){
+        return fnv_add(hash, "missing", 8);
+    }
+
+    hash = fnv_add(hash, &info.st_size, sizeof(info.st_size));
+    if (content == 0){
+        hash = fnv_add(hash, &info.st_mtim, sizeof(info.st_mtim));
+        hash = fnv_add(hash, &info.st_ino, sizeof(info.st_ino));
+        return fnv_add(hash, &info.st_dev, sizeof(info.st_dev));
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1){
+        return fnv_add(hash, "unreadable", 11);
+    }
+    while ((len = read(fd, chunk, sizeof(chunk))) > 0){
+        hash = fnv_add(hash, chunk, len);
+    }
+    close(fd);
+    return hash;
+}
+
+/***************************************************************
+ * memo_path
+ * Parameters: none
+ * Returns the newly allocated path of the cache file, HOME/
+ * .smallsh_memo, or SMALLSH_MEMO if that is set.
+****************************************************************/
+static char *memo_path(void){
+    char *override = getenv("SMALLSH_MEMO"), *home = getenv("HOME"), *path;
+
+    if (override != NULL){
+        return strdup(override);
+    }
+
+    home = (home == NULL) ? "." : home;
+    path = malloc(strlen(home) + strlen(MEMO_FILE) + 2);
+    if (path != NULL){
+        sprintf(path, "%s/%s", home, MEMO_FILE);
+    }
+    return path;
+}
+
+/***************************************************************
+ * read_record
+ * Parameters: FILE *file, memo_record *record
+ * Reads the next record of the cache file. Returns 1 on success,
+ * 0 at end of file.
+****************************************************************/
+static int read_record(FILE *file, memo_record *record){
+    return (fscanf(file, "%llx %d %d %lld %lld %ld %llu\n", &record->key,
+        &record->status_kind, &record->status_value, &record->out_size,
+        &record->out_mtime_sec, &record->out_mtime_nsec, &record->out_ino) == 7);
+}
+
+/***************************************************************
+ * memo_find
+ * Parameters: unsigned long long key, memo_record *found
+ * Searches the cache file for key. Returns 1 and fills found if
+ * it is there, otherwise 0.
+****************************************************************/
+static int memo_find(unsigned long long key, memo_record *found){
+    char *path = memo_path();
+    FILE *file = (path != NULL) ? fopen(path, "r") : NULL;
+    memo_record record;
+    int hit = 0;
+
+    while (file != NULL && read_record(file, &record) == 1){
+        if (record.key == key){
+            *found = record; // keep reading, the newest record wins
+            hit = 1;
+        }
+    }
+
+    if (file != NULL){
+        fclose(file);
+    }
+    free(path);
+    return hit;
+}
+
+/***************************************************************
+ * memo_save
+ * Parameters: memo_record *newRecord
+ * Rewrites the cache file with newRecord replacing any record of
+ * the same key. Only the newest MEMO_MAX_RECORDS are kept. The
+ * file is replaced by rename so readers never see half of it.
+****************************************************************/
+static void memo_save(memo_record *newRecord){
+    char *path = memo_path(), *tempPath = NULL;
+    memo_record *records = malloc(MEMO_MAX_RECORDS * sizeof(memo_record));
+    memo_record record;
+    FILE *file;
+    int count = 0, first = 0, i;
+
+    if (path == NULL || records == NULL){
+        free(path);
+        free(records);
+        return;
+    }
+
+    // keep the newest records other than newRecord's key, as a ring
+    file = fopen(path, "r");
+    while (file != NULL && read_record(file, &record) == 1){
+        if (record.key == newRecord->key){
+            continue;
+        }
+        if (count < MEMO_MAX_RECORDS - 1){
+            records[count++] = record;
+        } else {
+            records[first] = record;
+            first = (first + 1) % count;
+        }
+    }
+    if (file != NULL){
+        fclose(file);
+    }
+
+    tempPath = malloc(strlen(path) + 5);
+    file = NULL;
+    if (tempPath != NULL){
+        sprintf(tempPath, "%s.tmp", path);
+        file = fopen(tempPath, "w");
+    }
+
+    if (file != NULL){
+        for (i = 0; i <= count; i++){
+            memo_record *out = (i == count) ? newRecord : &records[(first + i) % count];
+            fprintf(file, "%016llx %d %d %lld %lld %ld %llu\n", out->key,
+                out->status_kind, out->status_value, out->out_size,
+                out->out_mtime_sec, out->out_mtime_nsec, out->out_ino);
+        }
+
+        if (fclose(file) == 0){
+            rename(tempPath, path);
+        } else {
+            unlink(tempPath);
+        }
+    }
+
+    free(tempPath);
+    free(path);
+    free(records);
+}
+
+/***************************************************************
+ * stat_output
+ * Parameters: char *outFile, memo_record *record
+ * Fills the output fields of record from outFile. Returns 0, or
+ * -1 if outFile does not exist.
+****************************************************************/
+static int stat_output(char *outFile, memo_record *record){
+    struct stat info;
+
+    if (stat(outFile, &info) == -1){
+        return -1;
+    }
+
+    record->out_size = info.st_size;
+    record->out_mtime_sec = info.st_mtim.tv_sec;
+    record->out_mtime_nsec = info.st_mtim.tv_nsec;
+    record->out_ino = info.st_ino;
+    return 0;
+}
+
+/***************************************************************
+ * memo_command
+ * Parameters: char **args, int total
+ * memo [-h] [-i FILE]... command > FILE runs command only if it,
+ * its < input, the extra -i inputs or its > output changed since
+ * the last successful run. The fingerprint covers the working
+ * directory, argv and each input's size, mtime and inode, or its
+ * contents with -h. When a record matches and the > output is
+ * still as that run left it, the command is skipped. Commands
+ * without a > output always run, and failed runs are never
+ * recorded. memo -s displays hit, miss and bytes saved counters.
+ * Returns the status of command, or 0 when it was skipped.
+****************************************************************/
+int memo_command(char **args, int total){
+    char cwd[PATH_MAX], *outFile = r_data.change_out ? r_data.out_file : NULL;
+    char **inputs = malloc((total + 1) * sizeof(char *));
+    unsigned long long key = FNV_OFFSET;
+    int numInputs = 0, content = 0, stats = 0, i = 1, j, result;
+    memo_record record, current;
+
+    if (inputs == NULL){
+        printf("Unable to allocate memory for memo\n");
+        fflush(stdout);
+        return 1;
+    }
+
+    if (r_data.change_in == 1){
+        inputs[numInputs++] = r_data.in_file;
+    }
+
+    // options precede the command
+    while (i < total){
+        if (strcmp(args[i], "-h") == 0){
+            content = 1;
+            i += 1;
+        } else if (strcmp(args[i], "-s") == 0){
+            stats = 1;
+            i += 1;
+        } else if (strcmp(args[i], "-i") == 0 && i + 1 < total){
+            inputs[numInputs++] = args[i+1];
+            i += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (stats == 1){
+        printf("memo: %ld hits, %ld misses, %lld bytes saved\n", memoHits, memoMisses, bytesSaved);
+        fflush(stdout);
+    }
+
+    if (i == total){
+        if (stats == 0){
+            printf("Usage: memo [-h] [-s] [-i FILE]... command\n");
+            fflush(stdout);
+        }
+        free(inputs);
+        return (stats == 1) ? 0 : 1;
+    }
+
+    // nothing to skip without an output, a background run has no
+    // status to record yet
+    if (outFile == NULL || background == 1){
+        free(inputs);
+        return execute_command(args + i, total - i);
+    }
+
+    // fingerprint everything the command depends on
+    if (getcwd(cwd, sizeof(cwd)) != NULL){
+        key = fnv_add(key, cwd, strlen(cwd) + 1);
+    }
+    for (j = i; j < total; j++){
+        key = fnv_add(key, args[j], strlen(args[j]) + 1);
+    }
+    for (j = 0; j < numInputs; j++){
+        key = add_input(key, inputs[j], content);
+    }
+    key = fnv_add(key, outFile, strlen(outFile) + 1);
+    free(inputs);
+
+    // skip the run if the output is still what the recorded run left
+    if (memo_find(key, &record) == 1 && stat_output(outFile, &current) == 0 &&
+        current.out_size == record.out_size && current.out_ino == record.out_ino &&
+        current.out_mtime_sec == record.out_mtime_sec &&
+        current.out_mtime_nsec == record.out_mtime_nsec){
+        memoHits++;
+        bytesSaved += (record.out_size > 0) ? record.out_size : 0;
+
+        last_fore_proc[0] = -100;
+        last_fore_proc[1] = record.status_kind;
+        last_fore_proc[2] = record.status_value;
+        return status_code();
+    }
+
+    memoMisses++;
+    result = execute_command(args + i, total - i);
+
+    // only successful runs bring the output up to date
+    if (last_fore_proc[1] != 1 || last_fore_proc[2] != 0 || stat_output(outFile, &record) == -1){
+        return result;
+    }
+
+    record.key = key;
+    record.status_kind = last_fore_proc[1];
+    record.status_value = last_fore_proc[2];
+    memo_save(&record);
+    return result;
+}
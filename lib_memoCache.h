@@ -0,0 +1,19 @@
+#ifndef LIB_MEMOCACHE_H_INCLUDED
+#define LIB_MEMOCACHE_H_INCLUDED
+
+#define MEMO_FILE ".smallsh_memo" // cache file kept in HOME
+#define MEMO_MAX_RECORDS 1000 // newest records kept in the cache file
+
+typedef struct memo_record {
+    unsigned long long key; // fingerprint of command and inputs
+    int status_kind; // last_fore_proc[1] of the recorded run
+    int status_value; // last_fore_proc[2] of the recorded run
+    long long out_size; // > file as left by the run
+    long long out_mtime_sec;
+    long out_mtime_nsec;
+    unsigned long long out_ino;
+} memo_record;
+
+int memo_command(char **, int);
+
+#endif
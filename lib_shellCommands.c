@@ -6,7 +6,22 @@
 #include <string.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <errno.h>
+#include <ctype.h>
+#include <poll.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/syscall.h>
 #include "lib_shellCommands.h"
+#include "lib_globExpand.h"
+#include "lib_jobOutput.h"
+#include "lib_memoCache.h"
+#include "lib_statusBoard.h"
+
+static volatile sig_atomic_t waitInterrupted = 0; // ctrl-c received during wait
+static variable *shell_vars = NULL; // variables set by for loops and NAME=value
+static int captureFDs[2] = {-1, -1}; // output pipe for the background process being started
+static void wait_interrupt(int);
 
 
 /***************************************************************
@@ -27,8 +42,9 @@ void exit_command(void){
  * If numArgs == 1, changes directory to HOME. If numArgs == 2,
  * uses the second element of newDirectory as the path. Otherwise,
  * error due to too many arguments are path not found is displayed.
+ * Returns 0 on success or 1.
 ****************************************************************/
-void change_directory(char **newDirectory, int numArgs){
+int change_directory(char **newDirectory, int numArgs){
     int completed = -100;
 
     switch(numArgs){
@@ -46,14 +62,16 @@ void change_directory(char **newDirectory, int numArgs){
         default:
             printf("No matching commands for number of arguments recived.\n");
             fflush(stdout);
-            return;
+            return 1;
     }
 
     // notify if path not found
     if (completed != 0){
         printf("Unable to find the request path.\n");
         fflush(stdout);
+        return 1;
     }
+    return 0;
 }
 
 /***************************************************************
@@ -61,7 +79,8 @@ void change_directory(char **newDirectory, int numArgs){
  * Parameters:
  * Displays exit or terminating status of last foreground
  * procedure stored in last_fore_proc. [0] -> pid, [1]=1 -> exited
- * normally, [2] -> exit or signal #.
+ * normally, [1]=2 -> terminated by signal, [1]=3 or 4 -> timed
+ * out then exited or was terminated, [2] -> exit or signal #.
 ****************************************************************/
 void get_status(void){
 
@@ -71,6 +90,12 @@ void get_status(void){
     } else if (last_fore_proc[1] == 2) { // terminated by signal
         printf("terminated by signal %d\n", last_fore_proc[2]);
         fflush(stdout);
+    } else if (last_fore_proc[1] == 3) { // timed out, exited on SIGTERM
+        printf("timed out, exited with status %d\n", last_fore_proc[2]);
+        fflush(stdout);
+    } else if (last_fore_proc[1] == 4) { // timed out, killed
+        printf("timed out, terminated by signal %d\n", last_fore_proc[2]);
+        fflush(stdout);
     } else { // no foreground process, return 0
         printf("No foreground process: exit status 0\n");
         fflush(stdout);
@@ -78,18 +103,358 @@ void get_status(void){
 
 }
 
+/***************************************************************
+ * status_code
+ * Parameters:
+ * Returns last_fore_proc as a shell exit code: 0 if there was no
+ * foreground process, the exit value, or 128 + the signal number.
+ * A process stopped by its deadline returns TIMED_OUT_STATUS (124)
+ * however it then ended, so a timeout never counts as success.
+****************************************************************/
+int status_code(void){
+
+    if (last_fore_proc[1] == 3 || last_fore_proc[1] == 4){
+        return TIMED_OUT_STATUS;
+    }
+    if (last_fore_proc[1] == 1){
+        return last_fore_proc[2];
+    }
+    return (last_fore_proc[1] == 0) ? 0 : 128 + last_fore_proc[2];
+}
+
+/***************************************************************
+ * timeout_command
+ * Parameters: char **args, int total
+ * timeout DURATION [-k KILL_AFTER] command... runs command with
+ * a deadline stored in t_data. With -f or -b and no command, the
+ * duration becomes the default for foreground or background
+ * processes instead. With no arguments, displays the defaults.
+ * Returns the status of command, TIMED_OUT_STATUS if it ran past
+ * its deadline, or 1 on a usage error.
+****************************************************************/
+int timeout_command(char **args, int total){
+    long duration = -1, kill_after = DEFAULT_KILL_AFTER;
+    int setFore = 0, setBack = 0, i = 1, result;
+
+    if (total == 1){ // display shell-wide defaults
+        printf("foreground timeout %ld ms, background timeout %ld ms\n",
+            fore_default.duration, back_default.duration);
+        fflush(stdout);
+        return 0;
+    }
+
+    // options and duration precede the command
+    while (i < total){
+        if (strcmp(args[i], "-k") == 0 && i + 1 < total){
+            kill_after = parse_duration(args[i+1]);
+            i += 2;
+        } else if (strcmp(args[i], "-f") == 0){
+            setFore = 1;
+            i += 1;
+        } else if (strcmp(args[i], "-b") == 0){
+            setBack = 1;
+            i += 1;
+        } else if (duration == -1){
+            duration = parse_duration(args[i]);
+            if (duration == -1){
+                break;
+            }
+            i += 1;
+        } else {
+            break; // start of command
+        }
+
+        if (kill_after == -1){
+            break;
+        }
+    }
+
+    if (duration == -1 || kill_after == -1){
+        printf("Usage: timeout DURATION [-k KILL_AFTER] command | timeout -f|-b DURATION [-k KILL_AFTER]\n");
+        fflush(stdout);
+        return 1;
+    }
+
+    // update defaults rather than running a command
+    if (setFore == 1 || setBack == 1){
+        if (setFore == 1){
+            fore_default.duration = duration;
+            fore_default.kill_after = kill_after;
+        }
+        if (setBack == 1){
+            back_default.duration = duration;
+            back_default.kill_after = kill_after;
+        }
+        return 0;
+    }
+
+    if (i == total){
+        printf("timeout: missing command to run\n");
+        fflush(stdout);
+        return 1;
+    }
+
+    t_data.duration = duration;
+    t_data.kill_after = kill_after;
+    result = execute_command(args + i, total - i);
+    t_data.duration = 0;
+    t_data.kill_after = 0;
+    return result;
+}
+
+/***************************************************************
+ * parse_duration
+ * Parameters: char *text
+ * Converts a duration such as 10, 1.5, 500ms, 2m, 1h or 1d to
+ * milliseconds. Plain numbers are seconds. Returns -1 if text
+ * is not a valid duration, including nan, inf and durations too
+ * long to add to the clock.
+****************************************************************/
+long parse_duration(char *text){
+    char *unit = NULL;
+    double value = strtod(text, &unit);
+
+    if (unit == text || !isfinite(value) || value < 0){
+        return -1;
+    }
+
+    if (strcmp(unit, "") == 0 || strcmp(unit, "s") == 0){
+        value *= 1000;
+    } else if (strcmp(unit, "m") == 0){
+        value *= 60 * 1000;
+    } else if (strcmp(unit, "h") == 0){
+        value *= 60 * 60 * 1000;
+    } else if (strcmp(unit, "d") == 0){
+        value *= 24 * 60 * 60 * 1000;
+    } else if (strcmp(unit, "ms") != 0){
+        return -1;
+    }
+
+    // half of LONG_MAX leaves room to add the current time
+    if (value >= (double)(LONG_MAX / 2)){
+        return -1;
+    }
+
+    return (long)value;
+}
+
+/***************************************************************
+ * wait_command
+ * Parameters: char **args, int total
+ * wait blocks until every background process finishes, wait
+ * PID... until the listed ones finish and wait -n until the first
+ * one does. All pidfds are waited on together in a single poll
+ * set. The last process waited for becomes the status reported by
+ * status. Ctrl-C stops waiting. Returns the status of the last
+ * process waited for, 127 for an unknown pid or 130 if stopped.
+****************************************************************/
+int wait_command(char **args, int total){
+    int *targets, numTargets = 0, firstOnly = 0, i, j, pid, ready, nfds, result = 0;
+    int childStatus, fallback, reaped;
+    struct pollfd *fds;
+    struct sigaction int_sig = {0};
+    char *end;
+    LinkedList current;
+    Proc_info *job;
+
+    targets = malloc((total + count_nodes(all_proc)) * sizeof(int));
+    fds = malloc((total + count_nodes(all_proc) + 1) * sizeof(struct pollfd));
+    if (targets == NULL || fds == NULL){
+        printf("Unable to allocate memory for wait\n");
+        fflush(stdout);
+        free(targets);
+        free(fds);
+        return 1;
+    }
+
+    // collect the pids to wait for
+    for (i = 1; i < total; i++){
+        if (strcmp(args[i], "-n") == 0){
+            firstOnly = 1;
+            continue;
+        }
+
+        pid = (int)strtol(args[i], &end, 10);
+        if (end == args[i] || *end != '\0' || find_node(all_proc, pid) == NULL){
+            printf("wait: %s is not a background process of this shell\n", args[i]);
+            fflush(stdout);
+            record_status(-100, 127 << 8, 0);
+            result = 127;
+            continue;
+        }
+
+        // a pid listed twice is only waited for once
+        for (j = 0; j < numTargets && targets[j] != pid; j++){
+            continue;
+        }
+        if (j == numTargets){
+            targets[numTargets++] = pid;
+        }
+    }
+
+    // no pids given, wait for every background process
+    if (numTargets == 0 && (total == 1 || (total == 2 && firstOnly == 1))){
+        for (current = all_proc; current != NULL; current = current->next){
+            targets[numTargets++] = current->data->pid;
+        }
+    }
+
+    // let ctrl-c interrupt poll while waiting
+    waitInterrupted = 0;
+    int_sig.sa_handler = wait_interrupt;
+    sigfillset(&int_sig.sa_mask);
+    sigaction(SIGINT, &int_sig, NULL);
+
+    while (numTargets > 0 && waitInterrupted == 0){
+        nfds = 0;
+        fallback = 0;
+        for (i = 0; i < numTargets; i++){
+            job = find_node(all_proc, targets[i]);
+            if (job != NULL && job->pidfd != -1){
+                fds[nfds].fd = job->pidfd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                nfds++;
+            } else {
+                fallback = 1;
+            }
+        }
+
+        // without pidfds, check in on processes every 10ms
+        ready = shell_poll(fds, nfds, (fallback == 1) ? 10 : -1);
+        if (ready <= 0 && fallback == 0){
+            continue;
+        }
+
+        // reap whichever targets have finished
+        for (i = 0; i < numTargets; i++){
+            pid = targets[i];
+            job = find_node(all_proc, pid);
+            reaped = (job != NULL) ? waitpid(pid, &childStatus, WNOHANG) : -1;
+            if (reaped == 0){
+                continue;
+            }
+
+            if (reaped == pid){
+                record_status(pid, childStatus, job->timed_out == 1);
+                report_background(pid, childStatus);
+                result = status_code();
+            }
+
+            // finished, or no longer a child to wait for, either way drop it
+            for (j = i; j < numTargets - 1; j++){
+                targets[j] = targets[j+1];
+            }
+            numTargets--;
+            i--;
+
+            if (firstOnly == 1 && reaped == pid){
+                numTargets = 0;
+            }
+        }
+    }
+
+    if (waitInterrupted == 1){
+        printf("\n");
+        fflush(stdout);
+        last_fore_proc[0] = -100;
+        last_fore_proc[1] = 2; // terminated by SIGINT
+        last_fore_proc[2] = SIGINT;
+        result = 128 + SIGINT;
+    }
+
+    sigaction(SIGINT, &ignore_sig, NULL);
+    free(targets);
+    free(fds);
+    return result;
+}
+
+/***************************************************************
+ * wait_interrupt
+ * Parameters: int sig_num
+ * SIGINT handler while the wait builtin is blocked
+****************************************************************/
+static void wait_interrupt(int sig_num){
+    waitInterrupted = 1;
+}
+
+/***************************************************************
+ * report_background
+ * Parameters: int childPID, int childStatus
+ * Displays how a reaped background process ended and stops
+ * tracking it in all_proc.
+****************************************************************/
+void report_background(int childPID, int childStatus){
+    Proc_info *job = find_node(all_proc, childPID);
+
+    printf("Background PID %d %sterminated ", childPID,
+        (job != NULL && job->timed_out == 1) ? "timed out, " : "");
+    fflush(stdout);
+
+    if(WIFEXITED(childStatus)){
+        printf("with exit value %d.\n", WEXITSTATUS(childStatus));
+        fflush(stdout);
+    } 
+    else{
+        printf("by signal %d.\n", WTERMSIG(childStatus));
+        fflush(stdout);
+    }
+
+    capture_finish(childPID, childStatus); //-->lib_jobOutput
+    remove_node(&all_proc, childPID);
+    board_reaped(); //-->lib_statusBoard
+    board_publish();
+}
+
+/***************************************************************
+ * record_status
+ * Parameters: int childPID, int childStatus, int timedOut
+ * Saves a wait status in last_fore_proc for the status builtin.
+****************************************************************/
+void record_status(int childPID, int childStatus, int timedOut){
+    last_fore_proc[0] = childPID;
+
+    if(WIFEXITED(childStatus)){
+        last_fore_proc[1] = (timedOut == 1) ? 3 : 1;
+        last_fore_proc[2] = WEXITSTATUS(childStatus);
+    } 
+    else{
+        last_fore_proc[1] = (timedOut == 1) ? 4 : 2;
+        last_fore_proc[2] = WTERMSIG(childStatus);
+    }
+}
+
 /***************************************************************
  * execute_command
  * Parameters: char **args
  * Creates a new process via fork() and executes requested
  * process via execlp. If fork or execution fails, appropriate
  * message is displayed, exit status set to 1, and created process
- * is terminated. Created process and exit status/signal saved in
- * last_fore_proc.
+ * is terminated. track_child handles the parent side.
+ * Returns the status of a foreground process, otherwise 0 once a
+ * background process has started or 1 if it could not be.
 ****************************************************************/
-void execute_command(char **args, int total){
-    int childStatus, childPid, i;
+int execute_command(char **args, int total){
+    char *command;
+    int i, result;
 
+    // report oversized argv here rather than as an exec failure
+    if (args_fit(args) == 0){
+        if (background == 0){
+            last_fore_proc[1] = 1;
+            last_fore_proc[2] = 1;
+        }
+        background = 0;
+        return 1;
+    }
+
+    // background output goes to a pipe the shell drains
+    if (background == 1 && capture_pipe(captureFDs) == -1){
+        captureFDs[0] = -1;
+        captureFDs[1] = -1;
+    }
+
+    long long forkStart = monotonic_us();
     pid_t child = fork(); // new process
     switch(child){
 
@@ -129,56 +494,252 @@ void execute_command(char **args, int total){
             }
 
         default:
-            // run as background process, add pid to linked list, and
-            // reset background global.
-            if(background == 1){
-                add_node(&all_proc, child);
-                printf("Starting background PID %d.\n", child);
-                fflush(stdout);
-                background = 0;
-            }
+            board_spawned(monotonic_us() - forkStart); //-->lib_statusBoard
+            command = join_args(args);
+            result = track_child(child, (command != NULL) ? command : args[0]);
+            free(command);
+            return result;
+    }
 
-            // run as foreground process
-            else {
-                // block SIGTSTP
-                if (sigprocmask(SIG_BLOCK, &tstp_mask, NULL) != 0){
-                    printf("Unable to block SIGTSTP\n");
-                    fflush(stdout);
-                }
+}
+
+/***************************************************************
+ * join_args
+ * Parameters: char **args
+ * Returns a newly allocated copy of args separated by spaces
+****************************************************************/
+char *join_args(char **args){
+    size_t len = 0, i;
+    char *joined;
 
-                // obtain child status
-                childPid = waitpid(child, &childStatus, 0);
+    for (i = 0; args[i] != NULL; i++){
+        len += strlen(args[i]) + 1;
+    }
 
-                // unblock SIGTSTP
-                if (sigprocmask(SIG_UNBLOCK, &tstp_mask, NULL) != 0){
-                    printf("Unable to unblock SIGTSTP\n");
-                    fflush(stdout);
-                }
-
-                // preserve child data and display signal received
-                last_fore_proc[0] = child;
-
-                if(WIFEXITED(childStatus)){
-                    last_fore_proc[1] = 1;
-                    last_fore_proc[2] = WEXITSTATUS(childStatus);
-                } 
-                else{
-                    last_fore_proc[1] = 2;
-                    last_fore_proc[2] = WTERMSIG(childStatus);
-                    printf("\nterminated by signal %d\n", last_fore_proc[2]);
-                    fflush(stdout);
-                }
+    joined = malloc(len + 1);
+    if (joined == NULL){
+        return NULL;
+    }
+
+    joined[0] = '\0';
+    for (i = 0; args[i] != NULL; i++){
+        strcat(joined, args[i]);
+        if (args[i+1] != NULL){
+            strcat(joined, " ");
+        }
+    }
+    return joined;
+}
+
+/***************************************************************
+ * track_child
+ * Parameters: int child, char *command
+ * Parent side of a fork. A background child is added to all_proc
+ * with its pidfd and deadline, its output pipe is handed to
+ * lib_jobOutput and background is reset. Otherwise waits for the
+ * foreground child and saves its status in last_fore_proc.
+ * Returns 0 for a background child, else its status_code.
+****************************************************************/
+int track_child(int child, char *command){
+    int childStatus, timedOut;
+    timer *limit;
+    Proc_info *job;
+
+    // run as background process, add pid to linked list, and
+    // reset background global.
+    if(background == 1){
+        limit = (t_data.duration > 0) ? &t_data : &back_default;
+        job = add_node(&all_proc, child);
+        if (job != NULL){
+            job->pidfd = open_pidfd(child);
+            job->command = strdup(command);
+            job->start_ms = wall_ms();
+        }
+        if (job != NULL && limit->duration > 0){
+            job->deadline = monotonic_ms() + limit->duration;
+            job->kill_after = limit->kill_after;
+        }
+        if (captureFDs[0] != -1){
+            close(captureFDs[1]);
+            capture_track(child, captureFDs[0], command); //-->lib_jobOutput
+            captureFDs[0] = -1;
+            captureFDs[1] = -1;
+        }
+        printf("Starting background PID %d.\n", child);
+        fflush(stdout);
+        background = 0;
+        board_publish(); //-->lib_statusBoard
+        return 0;
+    }
+
+    // run as foreground process
+    limit = (t_data.duration > 0) ? &t_data : &fore_default;
+
+    // block SIGTSTP
+    if (sigprocmask(SIG_BLOCK, &tstp_mask, NULL) != 0){
+        printf("Unable to block SIGTSTP\n");
+        fflush(stdout);
+    }
+
+    // obtain child status
+    timedOut = wait_foreground(child, limit, &childStatus);
+
+    // unblock SIGTSTP
+    if (sigprocmask(SIG_UNBLOCK, &tstp_mask, NULL) != 0){
+        printf("Unable to unblock SIGTSTP\n");
+        fflush(stdout);
+    }
+
+    // preserve child data and display signal received
+    record_status(child, childStatus, timedOut);
+    board_publish(); //-->lib_statusBoard
+
+    if(!WIFEXITED(childStatus)){
+        printf("\n%sterminated by signal %d\n",
+            (timedOut == 1) ? "timed out, " : "", last_fore_proc[2]);
+        fflush(stdout);
+    }
+    return status_code();
+}
+
+/***************************************************************
+ * wait_foreground
+ * Parameters: int child, timer *limit, int *childStatus
+ * Waits for child to finish and stores its wait status in
+ * childStatus. Waiting is done by polling a pidfd so that the
+ * deadline in limit (if any) can send SIGTERM and, after the
+ * grace period, SIGKILL without forking a helper process.
+ * Returns 1 if child was signalled for timing out, otherwise 0.
+****************************************************************/
+int wait_foreground(int child, timer *limit, int *childStatus){
+    long long deadline = -1, now;
+    int pidfd, ready, timeout, termSent = 0;
+    struct pollfd exited;
+
+    if (limit->duration > 0){
+        deadline = monotonic_ms() + limit->duration;
+    }
+
+    // nothing to time, block until the child is done
+    pidfd = open_pidfd(child);
+    if (pidfd == -1 && deadline < 0 && next_deadline(all_proc) < 0){
+        waitpid(child, childStatus, 0);
+        return 0;
+    }
+
+    exited.fd = pidfd;
+    exited.events = POLLIN;
+
+    while (1){
+        now = monotonic_ms();
+        timeout = (deadline < 0) ? -1 : (int)((deadline > now) ? deadline - now : 0);
+
+        // without a pidfd, check in on the child every 10ms
+        if (pidfd == -1){
+            if (waitpid(child, childStatus, WNOHANG) == child){
+                return termSent;
             }
+            timeout = (timeout < 0 || timeout > 10) ? 10 : timeout;
+        }
 
+        ready = shell_poll(&exited, (pidfd == -1) ? 0 : 1, timeout);
+        if (ready > 0){
             break;
+        }
+
+        if (deadline >= 0 && monotonic_ms() >= deadline){
+            if (termSent == 0){ // deadline reached, start grace period
+                kill(child, SIGTERM);
+                termSent = 1;
+                deadline = monotonic_ms() + limit->kill_after;
+            } else { // grace period over
+                kill(child, SIGKILL);
+                deadline = -1;
+            }
+        }
     }
 
+    close(pidfd);
+    waitpid(child, childStatus, 0);
+    return termSent;
+}
+
+/***************************************************************
+ * shell_poll
+ * Parameters: struct pollfd *fds, int nfds, int timeout
+ * poll() wrapper used whenever the shell waits on something.
+ * Wakes up in time to enforce background process deadlines and
+ * drains background output pipes as they fill. Never waits
+ * longer than timeout ms (-1 waits indefinitely).
+ * Returns the number of ready fds, 0 on timeout or interruption.
+****************************************************************/
+int shell_poll(struct pollfd *fds, int nfds, int timeout){
+    long long wake = next_deadline(all_proc), now = monotonic_ms();
+    int numCaptures = capture_count(), ready, i;
+    struct pollfd *all = fds;
+
+    // shorten timeout to the next background deadline
+    if (wake >= 0){
+        wake = (wake > now) ? wake - now : 0;
+        if (timeout < 0 || wake < timeout){
+            timeout = (int)wake;
+        }
+    }
+
+    // also wait on background output pipes, after the caller's fds
+    if (numCaptures > 0){
+        all = malloc((nfds + numCaptures) * sizeof(struct pollfd));
+        if (all == NULL){
+            all = fds;
+            numCaptures = 0;
+        } else {
+            memcpy(all, fds, nfds * sizeof(struct pollfd));
+            numCaptures = capture_pollfds(all + nfds, numCaptures);
+        }
+    }
+
+    ready = poll(all, nfds + numCaptures, timeout);
+    if (ready == -1){ // interrupted by a signal (e.g. SIGTSTP)
+        ready = 0;
+        board_publish(); // foreground-only mode may have changed
+    } else if (all != fds){ // drain pipes, count only the caller's fds
+        capture_drain(all + nfds, numCaptures);
+        ready = 0;
+        for (i = 0; i < nfds; i++){
+            fds[i].revents = all[i].revents;
+            ready += (fds[i].revents != 0);
+        }
+    }
+
+    if (all != fds){
+        free(all);
+    }
+
+    enforce_deadlines(all_proc);
+    return ready;
+}
+
+/***************************************************************
+ * open_pidfd
+ * Parameters: int pid
+ * Returns a pidfd that polls readable once pid exits, or -1 if
+ * the kernel does not support pidfd_open.
+****************************************************************/
+int open_pidfd(int pid){
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
 }
 
 /***************************************************************
  * background_handler
  * Parameters: none
- * Sets STDIN and STDOUT for background processes to dev/null
+ * Sets STDIN for background processes to dev/null. STDOUT and
+ * STDERR go to the output pipe the shell captures, or STDOUT to
+ * dev/null if no pipe could be made.
 ****************************************************************/
 void background_handler(void){
     int tempFD;
@@ -197,6 +758,19 @@ void background_handler(void){
     }
     close(tempFD);
 
+    // change output and errors to the capture pipe
+    if (captureFDs[1] != -1){
+        close(captureFDs[0]);
+        if (dup2(captureFDs[1], STDOUT_FILENO) == -1 ||
+            dup2(captureFDs[1], STDERR_FILENO) == -1) {
+            printf("Unable to set STDOUT to the output pipe\n");
+            fflush(stdout); 
+            exit(1); 
+        }
+        close(captureFDs[1]);
+        return;
+    }
+
     // change output to dev/null
     tempFD = open("/dev/null", O_WRONLY | O_TRUNC);
     if (tempFD == -1){
@@ -263,4 +837,571 @@ void redirection_handler(void){
         close(tempFD);
     }
 
-}
\ No newline at end of file
+}
+
+/***************************************************************
+ * dispatch_command
+ * Parameters: char **args, int total
+ * exit, cd, status, timeout, wait, cache, jobs and memo are
+ * handled in the shell while other commands are executed as
+ * either a foreground or background process. Returns the
+ * command's status, 0 for success, for conditions of while loops.
+****************************************************************/
+int dispatch_command(char **args, int total){
+
+    board_command_run(); //-->lib_statusBoard
+
+    if (strcmp(args[0], "exit") == 0){
+        exit_command();
+    }
+
+    else if (strcmp(args[0], "cd") == 0){
+        return change_directory(args, total);
+    }
+
+    else if (strcmp(args[0], "status") == 0){
+        get_status();
+    }
+
+    else if (strcmp(args[0], "timeout") == 0){
+        return timeout_command(args, total);
+    }
+
+    else if (strcmp(args[0], "wait") == 0){
+        return wait_command(args, total);
+    }
+
+    else if (strcmp(args[0], "cache") == 0){
+        cache_stats();
+    }
+
+    else if (strcmp(args[0], "jobs") == 0){
+        return jobs_command(args, total); //-->lib_jobOutput
+    }
+
+    else if (strcmp(args[0], "memo") == 0){
+        return memo_command(args, total); //-->lib_memoCache
+    }
+
+    else{
+        return execute_command(args, total);
+    }
+    return 0;
+}
+
+/***************************************************************
+ * build_args
+ * Parameters: cmd_node *node, int *total
+ * Returns a NULL terminated argv for the words of node, or NULL
+ * after displaying why expansion failed. total is set to the
+ * number of arguments.
+ * Words flagged by the parser as plain are used straight from the
+ * tree. Only flagged words have $NAME variables and pathname
+ * patterns expanded into new strings.
+****************************************************************/
+char **build_args(cmd_node *node, int *total){
+    char **args = malloc((node->num_words + 1) * sizeof(char *));
+    char **grown, *word;
+    int i, found;
+
+    *total = 0;
+    for (i = 0; args != NULL && i < node->num_words; i++){
+        word = node->words[i];
+        if (node->word_flags[i] & WORD_VARS){
+            word = expand_word(word);
+            if (word == NULL){
+                free_args(node, args, *total);
+                args = NULL;
+                break;
+            }
+        }
+
+        found = (node->word_flags[i] != 0 && has_glob(word) == 1) ? glob_expand(word, &args, total) : 0;
+
+        if (found == -1){ // matches do not fit, abandon command
+            if (word != node->words[i]){
+                free(word);
+            }
+            free_args(node, args, *total);
+            return NULL;
+        }
+
+        if (found > 0){ // matches replace the word, make room for the rest
+            if (word != node->words[i]){
+                free(word);
+            }
+            grown = realloc(args, (*total + node->num_words - i) * sizeof(char *));
+            if (grown == NULL){
+                free_args(node, args, *total);
+            }
+            args = grown;
+        } else { // no pattern or no matches, keep as is
+            args[(*total)++] = word;
+        }
+    }
+
+    if (args == NULL){
+        printf("Unable to allocate memory for arguments\n");
+        fflush(stdout);
+        return NULL;
+    }
+
+    args[*total] = NULL;
+    return args;
+}
+
+/***************************************************************
+ * free_args
+ * Parameters: cmd_node *node, char **args, int total
+ * Free's an argv made by build_args. Arguments that are words of
+ * node belong to the tree and are skipped. They appear in the
+ * same order as in node, and expanded strings never share their
+ * address, so a forward scan tells them apart.
+****************************************************************/
+void free_args(cmd_node *node, char **args, int total){
+    int i, j, k = 0;
+
+    for (i = 0; args != NULL && i < total; i++){
+        for (j = k; j < node->num_words && args[i] != node->words[j]; j++){
+            continue;
+        }
+
+        if (j < node->num_words){ // borrowed from the tree
+            k = j + 1;
+        } else {
+            free(args[i]);
+        }
+    }
+    free(args);
+}
+
+/***************************************************************
+ * expand_word
+ * Parameters: char *word
+ * Returns a newly allocated copy of word with each $NAME and
+ * ${NAME} replaced by the shell variable, or environment
+ * variable, of that name. Unset names expand to nothing.
+****************************************************************/
+char *expand_word(char *word){
+    size_t size = strlen(word) + 1, used = 0, len, nameLen;
+    char *result = malloc(size), *grown, *value, *name, *end;
+
+    while (result != NULL && *word != '\0'){
+        value = NULL;
+        len = 1;
+
+        if (word[0] == '$' && word[1] == '{' && (end = strchr(word, '}')) != NULL){
+            name = word + 2;
+            nameLen = end - name;
+            len = end - word + 1;
+            value = "";
+        } else if (word[0] == '$' && (word[1] == '_' || isalpha((unsigned char)word[1]))){
+            name = word + 1;
+            for (nameLen = 1; name[nameLen] == '_' || isalnum((unsigned char)name[nameLen]); nameLen++){
+                continue;
+            }
+            len = nameLen + 1;
+            value = "";
+        }
+
+        if (value != NULL){ // look the name up
+            name = strndup(name, nameLen);
+            if (name == NULL){
+                free(result);
+                return NULL;
+            }
+            value = get_variable(name);
+            free(name);
+            value = (value == NULL) ? "" : value;
+        } else {
+            value = word; // copy one ordinary character
+        }
+
+        nameLen = (value == word) ? 1 : strlen(value);
+        if (used + nameLen + 1 > size){
+            size = (used + nameLen + 1) * 2;
+            grown = realloc(result, size);
+            if (grown == NULL){
+                free(result);
+                return NULL;
+            }
+            result = grown;
+        }
+
+        memcpy(result + used, value, nameLen);
+        used += nameLen;
+        word += len;
+    }
+
+    if (result != NULL){
+        result[used] = '\0';
+    }
+    return result;
+}
+
+/***************************************************************
+ * set_variable
+ * Parameters: char *name, char *value
+ * Sets shell variable name to a copy of value
+****************************************************************/
+void set_variable(char *name, char *value){
+    variable *current;
+    char *copy = strdup(value);
+
+    if (copy == NULL){
+        printf("Unable to allocate memory for variable %s\n", name);
+        fflush(stdout);
+        return;
+    }
+
+    for (current = shell_vars; current != NULL; current = current->next){
+        if (strcmp(current->name, name) == 0){
+            free(current->value);
+            current->value = copy;
+            return;
+        }
+    }
+
+    current = malloc(sizeof(variable));
+    if (current == NULL || (current->name = strdup(name)) == NULL){
+        printf("Unable to allocate memory for variable %s\n", name);
+        fflush(stdout);
+        free(current);
+        free(copy);
+        return;
+    }
+    current->value = copy;
+    current->next = shell_vars;
+    shell_vars = current;
+}
+
+/***************************************************************
+ * get_variable
+ * Parameters: char *name
+ * Returns the value of shell variable name, falling back to the
+ * environment, or NULL if it is not set.
+****************************************************************/
+char *get_variable(char *name){
+    variable *current;
+
+    for (current = shell_vars; current != NULL; current = current->next){
+        if (strcmp(current->name, name) == 0){
+            return current->value;
+        }
+    }
+
+    return getenv(name);
+}
+
+/***************************************************************
+ * is_assignment
+ * Parameters: char *word
+ * Returns 1 if word has the form NAME=value
+****************************************************************/
+int is_assignment(char *word){
+    int i;
+
+    if (word[0] != '_' && !isalpha((unsigned char)word[0])){
+        return 0;
+    }
+    for (i = 1; word[i] == '_' || isalnum((unsigned char)word[i]); i++){
+        continue;
+    }
+
+    return (word[i] == '=');
+}
+
+/***************************************************************
+ * run_assignments
+ * Parameters: cmd_node *node
+ * Returns 0 unless every word of node is NAME=value. In that case
+ * sets each variable, expanding $NAME in the value, and returns 1.
+****************************************************************/
+int run_assignments(cmd_node *node){
+    char *equals, *value;
+    int i;
+
+    for (i = 0; i < node->num_words; i++){
+        if (is_assignment(node->words[i]) == 0){
+            return 0;
+        }
+    }
+
+    for (i = 0; i < node->num_words; i++){
+        equals = strchr(node->words[i], '=');
+        value = (node->word_flags[i] & WORD_VARS) ? expand_word(equals + 1) : equals + 1;
+        if (value == NULL){
+            continue;
+        }
+
+        *equals = '\0'; // name ends at =
+        set_variable(node->words[i], value);
+        *equals = '=';
+
+        if (value != equals + 1){
+            free(value);
+        }
+    }
+
+    return 1;
+}
+
+/***************************************************************
+ * run_list
+ * Parameters: cmd_node *list
+ * Runs each command of a ; separated list in order, stopping
+ * early if one of them was exit. Returns the status of the last
+ * command run.
+****************************************************************/
+int run_list(cmd_node *list){
+    int result = 0;
+
+    while (list != NULL && shellRun == 1){
+        result = run_node(list);
+        list = list->next;
+    }
+    return result;
+}
+
+/***************************************************************
+ * run_node
+ * Parameters: cmd_node *node
+ * Runs one command. Simple commands use the node's redirections
+ * through r_data. A subshell, or any group or loop sent to the
+ * background, is run by a forked copy of the shell. Other groups
+ * and loops run in the shell itself. Returns the command's status.
+****************************************************************/
+int run_node(cmd_node *node){
+    char **args;
+    int total, result;
+
+    if (node->type == NODE_SUBSHELL || (node->type != NODE_SIMPLE && background == 1)){
+        return run_subshell(node);
+    }
+
+    if (node->type != NODE_SIMPLE){
+        return run_group(node);
+    }
+
+    if (run_assignments(node) == 1){
+        background = 0;
+        return 0;
+    }
+
+    // build_args has already said why, fail like an exec failure
+    args = build_args(node, &total);
+    if (args == NULL){
+        record_status(-100, 1 << 8, 0);
+        background = 0;
+        return 1;
+    }
+
+    // tree owns plain file names, r_data only borrows them
+    r_data.change_in = (node->in_file != NULL);
+    r_data.in_file = expand_file(node->in_file);
+    r_data.change_out = (node->out_file != NULL);
+    r_data.out_file = expand_file(node->out_file);
+
+    result = dispatch_command(args, total);
+
+    if (r_data.in_file != node->in_file){
+        free(r_data.in_file);
+    }
+    if (r_data.out_file != node->out_file){
+        free(r_data.out_file);
+    }
+    r_data.change_in = 0;
+    r_data.in_file = NULL;
+    r_data.change_out = 0;
+    r_data.out_file = NULL;
+    background = 0; // builtins do not consume a trailing &
+
+    free_args(node, args, total);
+    return result;
+}
+
+/***************************************************************
+ * expand_file
+ * Parameters: char *name
+ * Returns name with variables expanded for a redirection. name
+ * itself is returned when it has none (or memory ran out), so
+ * callers free the result only if it differs from name.
+****************************************************************/
+char *expand_file(char *name){
+    char *expanded;
+
+    if (name == NULL || strchr(name, '$') == NULL){
+        return name;
+    }
+
+    expanded = expand_word(name);
+    return (expanded == NULL) ? name : expanded;
+}
+
+/***************************************************************
+ * run_body
+ * Parameters: cmd_node *node
+ * Runs the list of a subshell or group, or every iteration of a
+ * loop. for sets its variable to each expanded word in turn.
+ * while repeats until its condition list fails. Both loops stop
+ * on exit or when a command is interrupted by ctrl-c. Returns the
+ * status of the last command of the body, 0 if none ran.
+****************************************************************/
+int run_body(cmd_node *node){
+    char **values;
+    int total, i, result = 0;
+
+    if (node->type == NODE_FOR){
+        values = build_args(node, &total);
+        for (i = 0; values != NULL && i < total && shellRun == 1; i++){
+            set_variable(node->var, values[i]);
+            result = run_list(node->body);
+            if (result == 128 + SIGINT){
+                break;
+            }
+        }
+        free_args(node, values, total);
+        return (values == NULL) ? 1 : result;
+    }
+
+    else if (node->type == NODE_WHILE){
+        while (shellRun == 1 && run_list(node->cond) == 0){
+            result = run_list(node->body);
+            if (result == 128 + SIGINT){
+                break;
+            }
+        }
+        return result;
+    }
+
+    return run_list(node->body);
+}
+
+/***************************************************************
+ * run_group
+ * Parameters: cmd_node *node
+ * Runs { list; } or a loop in the current shell. Redirections
+ * are opened once and installed on the shell's own stdin/stdout
+ * for the whole group or loop, then the originals are restored.
+ * Returns the status of the group, 1 if a redirection failed.
+****************************************************************/
+int run_group(cmd_node *node){
+    int savedIn = -1, savedOut = -1, tempFD, opened = 1, result = 1;
+    char *inFile = expand_file(node->in_file), *outFile = expand_file(node->out_file);
+
+    fflush(stdout);
+
+    if (inFile != NULL){
+        tempFD = open(inFile, O_RDONLY);
+        if (tempFD == -1){
+            printf("Unable to open or create %s for redirection\n", inFile);
+            fflush(stdout);
+            opened = 0;
+        } else {
+            savedIn = dup(STDIN_FILENO);
+            dup2(tempFD, STDIN_FILENO);
+            close(tempFD);
+        }
+    }
+
+    if (outFile != NULL && opened == 1){
+        tempFD = open(outFile, O_WRONLY | O_TRUNC | O_CREAT, 0777);
+        if (tempFD == -1){
+            printf("Unable to open or create %s to redirect output\n", outFile);
+            fflush(stdout);
+            opened = 0;
+        } else {
+            savedOut = dup(STDOUT_FILENO);
+            dup2(tempFD, STDOUT_FILENO);
+            close(tempFD);
+        }
+    }
+
+    if (opened == 1){
+        result = run_body(node);
+    } else {
+        record_status(-100, 1 << 8, 0);
+    }
+
+    if (inFile != node->in_file){
+        free(inFile);
+    }
+    if (outFile != node->out_file){
+        free(outFile);
+    }
+
+    // put the shell's own stdin and stdout back
+    fflush(stdout);
+    if (savedIn != -1){
+        dup2(savedIn, STDIN_FILENO);
+        close(savedIn);
+    }
+    if (savedOut != -1){
+        dup2(savedOut, STDOUT_FILENO);
+        close(savedOut);
+    }
+    return result;
+}
+
+/***************************************************************
+ * run_subshell
+ * Parameters: cmd_node *node
+ * Forks once and runs the group or loop in the child, so cd and
+ * variables changed by the list stay in the child. Redirections
+ * are applied once in the child and inherited by every command
+ * in the list. The child exits with the status of the last
+ * command, which is returned for a foreground child.
+****************************************************************/
+int run_subshell(cmd_node *node){
+    long long forkStart;
+    pid_t child;
+    int result;
+
+    // background output goes to a pipe the shell drains
+    if (background == 1 && capture_pipe(captureFDs) == -1){
+        captureFDs[0] = -1;
+        captureFDs[1] = -1;
+    }
+
+    fflush(stdout);
+    forkStart = monotonic_us();
+    child = fork();
+    switch(child){
+
+        case -1:
+            printf("fork() failed!\n");
+            fflush(stdout);
+            exit(1);
+
+        case 0:
+            if (background == 1){
+                background_handler();
+            } else {
+                sigaction(SIGINT, &default_sig, NULL);
+            }
+            sigaction(SIGTSTP, &ignore_sig, NULL);
+
+            r_data.change_in = (node->in_file != NULL);
+            r_data.in_file = expand_file(node->in_file);
+            r_data.change_out = (node->out_file != NULL);
+            r_data.out_file = expand_file(node->out_file);
+            redirection_handler();
+            r_data.change_in = 0;
+            r_data.change_out = 0;
+
+            // the parent still owns its background processes
+            free_linked_proc(&all_proc);
+            capture_reset();
+            board_detach();
+            background = 0;
+            last_fore_proc[1] = 0;
+
+            result = run_body(node);
+            fflush(stdout);
+            exit(result);
+
+        default:
+            board_spawned(monotonic_us() - forkStart);
+            return track_child(child, (node->type == NODE_SUBSHELL) ? "( ... )" : "{ ...; }");
+    }
+}
@@ -1,7 +1,18 @@
 #ifndef LIB_SHELLCOMMANDS_H_INCLUDED
 #define LIB_SHELLCOMMANDS_H_INCLUDED
 
+#include <poll.h>
 #include "lib_linkedProcesses.h"
+#include "lib_commandTree.h"
+
+typedef struct variable {
+    char *name;
+    char *value;
+    struct variable *next;
+} variable;
+
+#define DEFAULT_KILL_AFTER 5000 // ms grace period when timeout has no -k
+#define TIMED_OUT_STATUS 124 // status of a command stopped by its deadline, as coreutils
 
 typedef struct redir {
     int change_in;
@@ -10,21 +21,52 @@ typedef struct redir {
     char *out_file;
 } redir;
 
+typedef struct timer {
+    long duration; // ms before SIGTERM, 0 for no limit
+    long kill_after; // ms between SIGTERM and SIGKILL
+} timer;
+
 extern int shellRun;
 extern LinkedList all_proc;
 extern int last_fore_proc[];
 extern int background;
 extern int backgroundPermitted;
 extern redir r_data;
+extern timer t_data;
+extern timer fore_default, back_default;
 extern struct sigaction ignore_sig, default_sig, tstp_sig;
 extern sigset_t tstp_mask;
 
 void exit_command(void);
-void change_directory(char **, int);
+int change_directory(char **, int);
 void get_status(void);
-void execute_command(char **, int);
+int status_code(void);
+int timeout_command(char **, int);
+long parse_duration(char *);
+int wait_command(char **, int);
+void report_background(int, int);
+void record_status(int, int, int);
+int execute_command(char **, int);
+int track_child(int, char *);
+char *join_args(char **);
+int wait_foreground(int, timer *, int *);
+int shell_poll(struct pollfd *, int, int);
+int open_pidfd(int);
 void background_handler(void);
 void redirection_handler(void);
-// void clean_redir_data(void);
+int dispatch_command(char **, int);
+char **build_args(cmd_node *, int *);
+void free_args(cmd_node *, char **, int);
+char *expand_word(char *);
+char *expand_file(char *);
+void set_variable(char *, char *);
+char *get_variable(char *);
+int is_assignment(char *);
+int run_assignments(cmd_node *);
+int run_list(cmd_node *);
+int run_node(cmd_node *);
+int run_body(cmd_node *);
+int run_group(cmd_node *);
+int run_subshell(cmd_node *);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib_shellCommands.h"
+#include "lib_statusBoard.h"
+
+static status_board *board = NULL; // mapped record, NULL if not publishing
+static char boardName[64]; // shm name, used when boardPath is NULL
+static char *boardPath = NULL; // file from SMALLSH_STATUS, if created here
+static unsigned long long commandsRun = 0, jobsReaped = 0;
+static unsigned long long spawnHist[BOARD_BUCKETS];
+
+
+/***************************************************************
+ * board_open
+ * Parameters: none
+ * Creates and maps the status record. It is the file named by
+ * SMALLSH_STATUS if set, otherwise the POSIX shared memory
+ * segment /smallsh.PID. An existing file belongs to someone else
+ * and is left alone. SMALLSH_STATUS is removed from the
+ * environment so nested shells publish their own board. The
+ * shell runs normally without a board if it cannot be created.
+****************************************************************/
+void board_open(void){
+    char *path = getenv("SMALLSH_STATUS");
+    int fd;
+
+    if (path != NULL){
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd == -1){
+            printf("Unable to create status board %s\n", path);
+            fflush(stdout);
+        } else {
+            boardPath = strdup(path);
+        }
+        unsetenv("SMALLSH_STATUS"); // path is no longer used
+    } else {
+        // no live process can own this pid's segment, replace a stale one
+        snprintf(boardName, sizeof(boardName), BOARD_SHM_FORMAT, getpid());
+        shm_unlink(boardName);
+        fd = shm_open(boardName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd == -1){
+            boardName[0] = '\0';
+        }
+    }
+
+    if (fd == -1){
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(status_board)) == 0){
+        board = mmap(NULL, sizeof(status_board), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        board = (board == MAP_FAILED) ? NULL : board;
+    }
+    close(fd);
+
+    if (board == NULL){
+        board_close();
+        return;
+    }
+
+    memset(board, 0, sizeof(status_board));
+    board->shell_pid = getpid();
+    board->version = BOARD_VERSION;
+    board_publish();
+    __atomic_store_n(&board->magic, BOARD_MAGIC, __ATOMIC_RELEASE);
+}
+
+/***************************************************************
+ * board_close
+ * Parameters: none
+ * Unmaps and removes the status record this shell created when
+ * the shell exits
+****************************************************************/
+void board_close(void){
+
+    if (boardPath != NULL){
+        unlink(boardPath);
+    } else if (boardName[0] != '\0'){
+        shm_unlink(boardName);
+    }
+    board_detach();
+}
+
+/***************************************************************
+ * board_detach
+ * Parameters: none
+ * Stops publishing without removing the record. Used by forked
+ * copies of the shell so only the original writes to it.
+****************************************************************/
+void board_detach(void){
+
+    if (board != NULL){
+        munmap(board, sizeof(status_board));
+        board = NULL;
+    }
+    free(boardPath);
+    boardPath = NULL;
+    boardName[0] = '\0';
+}
+
+/***************************************************************
+ * board_publish
+ * Parameters: none
+ * Copies the shell's current state into the status record under
+ * the seqlock. Readers never block the shell, they retry instead.
+****************************************************************/
+void board_publish(void){
+    LinkedList current;
+    unsigned int seq;
+    int count = 0;
+
+    if (board == NULL){
+        return;
+    }
+
+    // odd seq marks the record as being written
+    seq = __atomic_load_n(&board->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&board->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    board->background_permitted = backgroundPermitted;
+    memcpy(board->last_fore_proc, last_fore_proc, sizeof(board->last_fore_proc));
+    board->updated_ms = wall_ms();
+    board->commands_run = commandsRun;
+    board->jobs_reaped = jobsReaped;
+    memcpy(board->spawn_hist, spawnHist, sizeof(spawnHist));
+
+    for (current = all_proc; current != NULL; current = current->next){
+        if (count < BOARD_MAX_JOBS){
+            board_job *job = &board->jobs[count];
+            job->pid = current->data->pid;
+            job->start_ms = current->data->start_ms;
+            strncpy(job->command, (current->data->command != NULL) ? current->data->command : "",
+                BOARD_CMD_LEN - 1);
+            job->command[BOARD_CMD_LEN - 1] = '\0';
+        }
+        count++;
+    }
+    board->num_jobs = count;
+
+    __atomic_store_n(&board->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/***************************************************************
+ * board_command_run
+ * Parameters: none
+ * Counts one command run by the shell
+****************************************************************/
+void board_command_run(void){
+    commandsRun++;
+}
+
+/***************************************************************
+ * board_spawned
+ * Parameters: long long micros
+ * Adds a fork that took micros microseconds to the histogram
+****************************************************************/
+void board_spawned(long long micros){
+    int bucket = 0;
+
+    while (bucket < BOARD_BUCKETS - 1 && micros >= (1LL << bucket)){
+        bucket++;
+    }
+    spawnHist[bucket]++;
+}
+
+/***************************************************************
+ * board_reaped
+ * Parameters: none
+ * Counts one reaped background process
+****************************************************************/
+void board_reaped(void){
+    jobsReaped++;
+}
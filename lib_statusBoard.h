@@ -0,0 +1,48 @@
+#ifndef LIB_STATUSBOARD_H_INCLUDED
+#define LIB_STATUSBOARD_H_INCLUDED
+
+#define BOARD_MAGIC 0x534d5348 // "SMSH"
+#define BOARD_VERSION 1
+#define BOARD_MAX_JOBS 64 // background processes listed on the board
+#define BOARD_CMD_LEN 128 // bytes of each command kept, including \0
+#define BOARD_BUCKETS 24 // spawn latency histogram buckets
+#define BOARD_SHM_FORMAT "/smallsh.%d" // shm name for a shell pid
+
+typedef struct board_job {
+    int pid;
+    long long start_ms; // wall clock ms since the epoch
+    char command[BOARD_CMD_LEN];
+} board_job;
+
+/***************************************************************
+ * status_board
+ * Layout of the shared status record. seq is a seqlock: the shell
+ * makes it odd before changing anything and even again after, so
+ * a reader retries if seq was odd or changed during its copy.
+ * spawn_hist[i] counts forks that took under 2^i microseconds,
+ * the last bucket counts everything slower.
+****************************************************************/
+typedef struct status_board {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int seq;
+    int shell_pid;
+    int background_permitted;
+    int last_fore_proc[3];
+    long long updated_ms;
+    unsigned long long commands_run;
+    unsigned long long jobs_reaped;
+    unsigned long long spawn_hist[BOARD_BUCKETS];
+    int num_jobs; // live jobs, may exceed BOARD_MAX_JOBS
+    board_job jobs[BOARD_MAX_JOBS];
+} status_board;
+
+void board_open(void);
+void board_close(void);
+void board_detach(void);
+void board_publish(void);
+void board_command_run(void);
+void board_spawned(long long);
+void board_reaped(void);
+
+#endif
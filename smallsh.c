@@ -8,7 +8,9 @@
  * execution route. lib_shellCommands contains cd, exit, status, 
  * and other executions. lib_linkedProcesses contains functions 
  * for terminating tracked background child process.
- * TODO: Remove node in check_backgroundPIDs(), reduce global vars
+ * lib_commandTree parses lines into commands and ( ) / { } groups.
+ * lib_statusBoard publishes live status for smallsh_status.
+ * TODO: reduce global vars
 ****************************************************************/
 
 
@@ -19,7 +21,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
 #include "lib_shellCommands.h"
+#include "lib_statusBoard.h"
 
 
 /***************************************************************
@@ -31,6 +35,8 @@ int last_fore_proc[3] = {-100, 0, 0}; // last foreground pid, exit/term, signal/
 int background = 0; // run as background boolean
 int backgroundPermitted = 1; // background permitted boolean
 redir r_data; //struct for tracking redirection
+timer t_data = {0, 0}; // deadline requested by timeout builtin
+timer fore_default = {0, 0}, back_default = {0, 0}; // shell-wide timeouts
 struct sigaction ignore_sig = {0}, default_sig = {0}, tstp_sig = {0}; //sigaction structs
 sigset_t tstp_mask; //signal set for blocking
 
@@ -39,9 +45,7 @@ void get_command(char **);
 void command_action(char *);
 char* expand_variable(char **);
 int number_integers(int);
-void parse_command(char *, int*, char ***);
 void check_backgroundPIDs(void);
-void clean_redir_data(void);
 void sigtstp_handler(int);
 
 int main(void){
@@ -83,10 +87,14 @@ int main(void){
         exit(1);
     }
 
+    // live status for monitoring tools -->lib_statusBoard
+    board_open();
+
     // main loop to mimic shell
     do{
         // check for completed background processes
         check_backgroundPIDs();
+        board_publish();
 
         // obtain command
         get_command(&command);
@@ -108,6 +116,7 @@ int main(void){
 
     free(command);
     command = NULL;
+    board_close();
 
     return 0;
 }
@@ -116,17 +125,60 @@ int main(void){
  * get_command
  * Parameters: char ** returnInput
  * Obtains command to execute and updates returnInput pointer
- * for main() execution
+ * for main() execution. stdin is read through shell_poll rather
+ * than getline so background deadlines are still enforced while
+ * waiting at the prompt. End of input is treated as exit.
 ****************************************************************/
 void get_command(char **returnInput){
-    char *input = NULL;
-    size_t len = 0;
-    ssize_t read = 0;
+    static char *buffer = NULL; // bytes read but not yet returned
+    static size_t used = 0, size = 0;
+    char *newline, *input;
+    struct pollfd in = {STDIN_FILENO, POLLIN, 0};
+    ssize_t read_in;
+    size_t len;
 
     printf("user@smallsh: ");
     fflush(stdout);
-    read = getline(&input, &len, stdin);
-    input[strlen(input)-1] = '\0'; // replace \n with \0
+
+    while ((newline = (used > 0) ? memchr(buffer, '\n', used) : NULL) == NULL){
+
+        // grow buffer for the next read
+        if (size - used < 512){
+            size = (size == 0) ? 1024 : size * 2;
+            buffer = realloc(buffer, size);
+            if (buffer == NULL){
+                printf("Unable to allocate memory for command.\n");
+                fflush(stdout);
+                exit(1);
+            }
+        }
+
+        if (shell_poll(&in, 1, -1) <= 0){
+            continue; // woke for a deadline or signal
+        }
+
+        read_in = read(STDIN_FILENO, buffer + used, size - used);
+        if (read_in == -1 && errno == EINTR){
+            continue;
+        }
+
+        if (read_in <= 0){ // end of input
+            if (used == 0){
+                *returnInput = strdup("exit");
+                return;
+            }
+            newline = buffer + used; // return the unterminated last line
+            break;
+        }
+        used += read_in;
+    }
+
+    // hand back the line without \n and keep the rest buffered
+    len = newline - buffer;
+    input = strndup(buffer, len);
+    len = (len < used) ? len + 1 : len;
+    memmove(buffer, buffer + len, used - len);
+    used -= len;
 
     *returnInput = input;
 }
@@ -134,65 +186,42 @@ void get_command(char **returnInput){
 /***************************************************************
  * command_action
  * Parameters: char *userInput
- * Calls expand_variable, parses command, and executes command.
- * exit, cd, and status commands handled in program while other
- * commands are handled as either a foreground or background
- * process
+ * Reuses the command tree of an identical earlier line when the
+ * parse cache has one. Otherwise calls expand_variable, parses
+ * the command into a command tree and caches it. exit, cd, and
+ * status commands handled in program while other commands are
+ * handled as either a foreground or background process
 ****************************************************************/
 void command_action(char *userInput){
-    char *altered = expand_variable(&userInput); //expand $$ variable to  shell pid
-    if (altered == NULL){
-        return;
-    }
-
-    char **parsed = malloc(1 * sizeof(char *));
-    int totalParsed=0, x;
-    char *copyString = strdup(altered);
-    char **test = NULL;
-    int i;
-
-    // parse the command and determine execution route
-    parse_command(altered, &totalParsed, &parsed);
-
-    if(strcmp(altered, "exit") == 0){exit_command();}
-
-    if (parsed != NULL){
-
-        if (strcmp(parsed[0], "exit") == 0){
-            exit_command(); //-->lib_shellCommands
-        }
+    int wantsBackground = 0, cached = 1;
+    cmd_node *tree = cache_lookup(userInput, &wantsBackground); //-->lib_commandTree
 
-        else if (strcmp(parsed[0], "cd") == 0){
-            change_directory(parsed, totalParsed); //-->lib_shellCommands
+    if (tree == NULL){
+        char *altered = expand_variable(&userInput); //expand $$ variable to  shell pid
+        if (altered == NULL){
+            return;
         }
 
-        else if (strcmp(parsed[0], "status") == 0){
-            get_status(); //-->lib_shellCommands
-        }
+        // parse the command and determine execution route
+        wantsBackground = (userInput[strlen(userInput)-1] == '&');
+        tree = parse_line(altered); //-->lib_commandTree
+        free(altered);
 
-        else{
-            execute_command(parsed, totalParsed); //-->lib_shellCommands
+        if (tree == NULL){
+            background = 0;
+            return;
         }
-
-    }
-    else {
-        printf("Unable to parse command.\n");
-        fflush(stdout);
+        cached = (cache_store(userInput, tree, wantsBackground) == 0);
     }
 
-    // free memory
-
-    if (r_data.change_in==1 || r_data.change_out==1){ //cleanup memory for redirection
-        clean_redir_data();
-    }
+    background = (wantsBackground == 1 && backgroundPermitted == 1);
+    run_node(tree); //-->lib_shellCommands
 
-    for(x=0;x<=totalParsed;x++){
-        free(parsed[x]);
+    // free memory
+    background = 0;
+    if (cached == 0){
+        free_tree(tree);
     }
-       
-    free(parsed);
-    free(copyString);
-    free(altered);
 }
 
 /***************************************************************
@@ -275,61 +304,6 @@ int number_integers(int a){
     return total;
 }
 
-/***************************************************************
- * parse_command
- * Parameters: char *string, int *total (expected value = 0)
- * Tokenizes string using space as a delimiter and increments
- * total for each string. Saves every substring in an array and 
- * returns array.
-****************************************************************/
-void parse_command(char *string, int *total, char ***returnArgs){
-    int x;
-    char *remaining;
-    char *test = NULL;
-
-    // tokenize string
-    char *token = strtok_r(string, " ", &remaining);
-
-    while(token){
-
-        // check for input redirection
-        if(strcmp(token, "<") == 0){
-            r_data.change_in = 1;
-            token = strtok_r(NULL, " ", &remaining);
-            r_data.in_file = strdup(token);
-            token = strtok_r(NULL, " ", &remaining);
-        }
-
-        // check for output redirection
-        else if(strcmp(token, ">") == 0){
-            r_data.change_out = 1;
-            token = strtok_r(NULL, " ", &remaining);
-            r_data.out_file = strdup(token);
-            token = strtok_r(NULL, " ", &remaining);
-        }
-
-        // otherwise save command and continue
-        else {
-            (*returnArgs)[*total] = strdup(token);
-            *total += 1;
-
-            // continue parsing and allocate more memory
-            token = strtok_r(NULL, " ", &remaining);
-            *returnArgs = realloc(*returnArgs, (*total + 1) * sizeof(char *));
-
-            if (*returnArgs== NULL){ //print memory error and return null
-                printf("Unable to allocate enough memory for command.\n");
-                fflush(stdout);
-                return;
-            }
-
-            (*returnArgs)[*total] = NULL;
-        }
-
-    }
-
-}
-
 /***************************************************************
  * check_backgroundPIDs
  * Parameters: None
@@ -347,41 +321,11 @@ void check_backgroundPIDs(void){
 
         // display exit or signal termination data
         if (childPID > 0){
-            printf("Background PID %d terminated ", childPID);
-            fflush(stdout);
-
-            if(WIFEXITED(childStatus)){
-                printf("with exit value %d.\n", WEXITSTATUS(childStatus));
-                fflush(stdout);
-            } 
-            else{
-                printf("by signal %d.\n", WTERMSIG(childStatus));
-                fflush(stdout);
-            }
-            // remove node
+            report_background(childPID, childStatus); //-->lib_shellCommands
         }
     } while(childPID > 0);
 }
 
-/***************************************************************
- * clean_redir_data
- * Parameters: None
- * Clears memory and resets booleans of r_data
-****************************************************************/
-void clean_redir_data(void){
-    if (r_data.change_in == 1){ //clean input redirection
-        r_data.change_in = 0;
-        free(r_data.in_file);
-        r_data.in_file = NULL;
-    }
-    
-    if (r_data.change_out == 1){ //clean output redirection
-        r_data.change_out = 0;
-        free(r_data.out_file);
-        r_data.out_file = NULL;
-    }
-}
-
 /***************************************************************
  * sigtstp_handler
  * Parameters: int sig_num
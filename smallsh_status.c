@@ -0,0 +1,184 @@
+/***************************************************************
+ * Description: Reads the status board of a running smallsh and
+ * displays it as JSON. The board is only mapped for reading, so
+ * the shell is never signalled or blocked by it.
+ * Usage: smallsh_status PID | smallsh_status PATH
+ * PID reads the shared memory segment of that shell, PATH the
+ * file it was given in SMALLSH_STATUS.
+****************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib_statusBoard.h"
+
+#define READ_RETRIES 1000 // copies attempted before giving up
+
+
+/***************************************************************
+ * map_board
+ * Parameters: char *target
+ * Maps the board named by target read only. Returns NULL and
+ * displays why if it cannot.
+****************************************************************/
+status_board *map_board(char *target){
+    char name[64];
+    struct stat info;
+    status_board *board;
+    int fd, i;
+
+    for (i = 0; isdigit((unsigned char)target[i]); i++){
+        continue;
+    }
+
+    if (i > 0 && target[i] == '\0'){
+        snprintf(name, sizeof(name), BOARD_SHM_FORMAT, atoi(target));
+        fd = shm_open(name, O_RDONLY, 0);
+    } else {
+        fd = open(target, O_RDONLY);
+    }
+
+    if (fd == -1){
+        printf("No status board found for %s\n", target);
+        fflush(stdout);
+        return NULL;
+    }
+
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(status_board)){
+        printf("%s is not a status board\n", target);
+        fflush(stdout);
+        close(fd);
+        return NULL;
+    }
+
+    board = mmap(NULL, sizeof(status_board), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (board == MAP_FAILED){
+        printf("Unable to map the status board of %s\n", target);
+        fflush(stdout);
+        return NULL;
+    }
+    return board;
+}
+
+/***************************************************************
+ * read_board
+ * Parameters: status_board *board, status_board *copy
+ * Copies board into copy under the seqlock, retrying while the
+ * shell is writing. Returns 0, or -1 if no clean copy was made.
+****************************************************************/
+int read_board(status_board *board, status_board *copy){
+    unsigned int before, after;
+    int tries;
+
+    for (tries = 0; tries < READ_RETRIES; tries++){
+        before = __atomic_load_n(&board->seq, __ATOMIC_ACQUIRE);
+        if ((before & 1) == 0){
+            memcpy(copy, board, sizeof(status_board));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&board->seq, __ATOMIC_RELAXED);
+            if (before == after){
+                return 0;
+            }
+        }
+        sched_yield();
+    }
+    return -1;
+}
+
+/***************************************************************
+ * print_string
+ * Parameters: char *text
+ * Displays text as a quoted JSON string
+****************************************************************/
+void print_string(char *text){
+    unsigned char c;
+
+    putchar('"');
+    for (; *text != '\0'; text++){
+        c = (unsigned char)*text;
+        if (c == '"' || c == '\\'){
+            printf("\\%c", c);
+        } else if (c < 0x20){
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+/***************************************************************
+ * print_board
+ * Parameters: status_board *board
+ * Displays board as a JSON object
+****************************************************************/
+void print_board(status_board *board){
+    int shown = (board->num_jobs < BOARD_MAX_JOBS) ? board->num_jobs : BOARD_MAX_JOBS;
+    int i;
+
+    printf("{\n  \"version\": %u,\n  \"shell_pid\": %d,\n", board->version, board->shell_pid);
+    printf("  \"updated_ms\": %lld,\n", board->updated_ms);
+    printf("  \"foreground_only\": %s,\n", board->background_permitted ? "false" : "true");
+    printf("  \"last_foreground\": {\"pid\": %d, \"kind\": %d, \"value\": %d},\n",
+        board->last_fore_proc[0], board->last_fore_proc[1], board->last_fore_proc[2]);
+    printf("  \"commands_run\": %llu,\n  \"jobs_reaped\": %llu,\n",
+        board->commands_run, board->jobs_reaped);
+
+    // bucket i counts forks under 2^i microseconds
+    printf("  \"spawn_us_histogram\": [");
+    for (i = 0; i < BOARD_BUCKETS; i++){
+        printf("%s%llu", (i == 0) ? "" : ", ", board->spawn_hist[i]);
+    }
+    printf("],\n");
+
+    printf("  \"num_jobs\": %d,\n  \"jobs\": [", board->num_jobs);
+    for (i = 0; i < shown; i++){
+        printf("%s\n    {\"pid\": %d, \"start_ms\": %lld, \"command\": ", (i == 0) ? "" : ",",
+            board->jobs[i].pid, board->jobs[i].start_ms);
+        board->jobs[i].command[BOARD_CMD_LEN - 1] = '\0';
+        print_string(board->jobs[i].command);
+        printf("}");
+    }
+    printf("%s]\n}\n", (shown > 0) ? "\n  " : "");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv){
+    status_board *board, copy;
+
+    if (argc != 2){
+        printf("Usage: smallsh_status PID|PATH\n");
+        fflush(stdout);
+        return 2;
+    }
+
+    board = map_board(argv[1]);
+    if (board == NULL){
+        return 1;
+    }
+
+    if (__atomic_load_n(&board->magic, __ATOMIC_ACQUIRE) != BOARD_MAGIC ||
+        board->version != BOARD_VERSION){
+        printf("%s is not a status board this reader understands\n", argv[1]);
+        fflush(stdout);
+        return 1;
+    }
+
+    if (read_board(board, &copy) == -1){
+        printf("Status board of %s kept changing, try again\n", argv[1]);
+        fflush(stdout);
+        return 1;
+    }
+
+    print_board(&copy);
+    munmap(board, sizeof(status_board));
+    return 0;
+}